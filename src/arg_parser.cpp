@@ -1,10 +1,24 @@
 #include "arg_parser.h"
 
 
-img_iter_saver::img_iter_saver(const std::string& imgPath, const ImageFormat f,
+img_iter_saver::img_iter_saver(const std::string& imgPath, const ImageFormat f, const DNAFormat df,
 	const img_iter& ii, SaveOption so, int num, std::ostream& os)
 : ii(ii), so(so), optNum(num), imgPath(imgPath), saveFormat(f),
-  saveExt(ImageFormatToExtension(saveFormat)), os(os) {
+  saveExt(ImageFormatToExtension(saveFormat)), dnaFormat(df),
+  dnaExt(DNAFormatToExtension(dnaFormat)), checkpointPath(imgPath + ".checkpoint"), os(os) {
+	writer = std::thread(&img_iter_saver::writeLoop, this);
+}
+
+
+// writes the snapshots still waiting
+img_iter_saver::~img_iter_saver() {
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stop = true;
+	}
+	queueCV.notify_one();
+	writer.join();
+	reportErrors();
 }
 
 
@@ -21,11 +35,110 @@ void img_iter_saver::save() {
 	os << "Iter: " << std::setw(6) << ii.iterations()
 	   << "\tImp: " << std::setw(6) << ii.improvements()
 	   << "\tFit: " << ii.fitness() * 100
-	   << "\tTime: " << std::setw(6) << ii.runtime() << " s"
-	   << std::endl;
+	   << "\tTime: " << std::setw(6) << ii.runtime() << " s";
+	if (ii.operatorStats().enabled(static_cast<int>(Mutation::Add)))
+		os << "\tPoly: " << ii.polygonCount();
+	const PrescreenStats& pre = ii.prescreenStats();
+	if (pre.checks > 0) {
+		os << "\tPre rej: " << pre.rejects << '/' << pre.checks
+		   << " wrong: " << pre.wrong << '/' << pre.audits
+		   << " passed worse: " << pre.passedWorse;
+	}
+	if (dropped > 0)
+		os << "\tDropped: " << dropped;
+	os << std::endl;
+	const OperatorSelector& ops = ii.operatorStats();
+	if (ops.adaptive()) {
+		os << "Ops:";
+		for (int i = 0; i < ops.count(); ++i) {
+			if (!ops.enabled(i))
+				continue;
+			const OperatorSelector::Stats& st = ops.stats(i);
+			os << ' ' << poly_mutator::mutationName(static_cast<Mutation>(i))
+			   << ' ' << std::setprecision(3) << ops.probability(i) * 100 << "% "
+			   << st.accepts << '/' << st.trials;
+		}
+		os << std::setprecision(6) << std::endl;
+	}
 	last = ii.improvements();
-	iw.write(ii.getImage(), saveImgPath(), saveFormat);
-	writeDNA(ii.getDNA(), saveDNAPath());
+
+	Snapshot snap;
+	snap.img.reset(ii.snapshot());
+	snap.dna = ii.getDNA();
+	if (checkpoints && snap.img != nullptr) {
+		ii.checkpoint(snap.checkpoint);
+		snap.checkpointed = true;
+	}
+	snap.imgPath = saveImgPath();
+	snap.dnaPath = saveDNAPath();
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (pending.size() < queueSize)
+			pending.push_back(std::move(snap));
+		else {
+			pending.back() = std::move(snap);
+			++dropped;
+		}
+	}
+	queueCV.notify_one();
+	reportErrors();
+}
+
+
+// writer thread: encodes and writes snapshots in order until stopped and drained
+void img_iter_saver::writeLoop() {
+	while (true) {
+		Snapshot snap;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCV.wait(lock, [this] () {return stop || !pending.empty();});
+			if (pending.empty())
+				return;
+			snap = std::move(pending.front());
+			pending.pop_front();
+		}
+		if (snap.img != nullptr) {
+			const ImageSnapshot& img = *snap.img;
+			row.resize(img.width());
+			bool ok = iw.begin(snap.imgPath, saveFormat, img.width(), img.height());
+			for (int y = 0; ok && y < img.height(); ++y) {
+				img.row(y, row.data());
+				ok = iw.writeRow(row.data());
+			}
+			if (ok)
+				iw.end();
+		}
+		writeDNA(snap.dna, snap.dnaPath, dnaFormat);
+		if (snap.checkpointed) {
+			snap.img->checkpoint(snap.checkpoint);
+			const std::vector<unsigned char>& data = snap.checkpoint.finish();
+			FileHelper::AtomicFile f;
+			if (!(f.open(checkpointPath) && f.write(data.data(), data.size()) && f.commit())) {
+				std::lock_guard<std::mutex> lock(queueMutex);
+				++checkpointErrors;
+			}
+		}
+	}
+}
+
+
+// reports checkpoint writes that failed since the last call (os is only
+// used by the iteration thread)
+void img_iter_saver::reportErrors() {
+	int failed;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		failed = checkpointErrors;
+		checkpointErrors = 0;
+	}
+	if (failed > 0)
+		os << "Error writing checkpoint" << std::endl;
+}
+
+
+// save the full engine state with each snapshot, see img_iter::resume
+void img_iter_saver::setCheckpoints(const bool c) {
+	checkpoints = c;
 }
 
 
@@ -69,7 +182,8 @@ std::string img_iter_saver::saveDNAPath() const {
 		tmp.insert(0, padSize - tmp.size(), '0');
 	}
 	ret += tmp;
-	ret += ".txt";
+	ret += '.';
+	ret += dnaExt;
 	return ret;
 }
 
@@ -122,6 +236,137 @@ arg_parser::arg_parser(const int argc, char** argv) {
 	arg_data.push_back(tmp);
 	tmp = empty_arg_data;
 
+	tmp.command = "threads";
+	tmp.arguments.push_back("number");
+	tmp.description = "number of threads (including main thread)";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "pin";
+	tmp.description = "pin threads to cores";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "pyramid";
+	tmp.arguments.push_back("levels");
+	tmp.description = "evolve on <levels> halved copies of the image first (coarse to fine)";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "prescreen";
+	tmp.arguments.push_back("stride");
+	tmp.arguments.push_back("margin");
+	tmp.description = "score every <stride> rows first, reject candidates worse by more than <margin> per pixel";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "guided";
+	tmp.description = "mutate polygons and vertices in high error areas more often";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "seed";
+	tmp.arguments.push_back("number");
+	tmp.description = "random seed (runs with the same seed and options are identical)";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "adaptive";
+	tmp.description = "adapt mutation operator probabilities to their success per evaluation cost";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "init";
+	tmp.arguments.push_back("strategy");
+	tmp.description = "initial polygons: random, simple, quadtree (-v 4 or more) or kmeans";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "metric";
+	tmp.arguments.push_back("metric");
+	tmp.description = "fitness metric: sad, sse, luma or perceptual";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "format";
+	tmp.arguments.push_back("format");
+	tmp.description = "snapshot image format: ppm (default) or qoi";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "dnaformat";
+	tmp.arguments.push_back("format");
+	tmp.description = "snapshot DNA format: txt (default) or dna (binary)";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "convert";
+	tmp.arguments.push_back("in");
+	tmp.arguments.push_back("out");
+	tmp.description = "convert a DNA file to txt or dna by the extension of <out>, then exit";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "journal";
+	tmp.arguments.push_back("interval");
+	tmp.description = "record accepted mutations to <input>.journal, with the full DNA every <interval> improvements";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "replay";
+	tmp.arguments.push_back("journal");
+	tmp.arguments.push_back("improvement");
+	tmp.arguments.push_back("out");
+	tmp.description = "write the DNA at <improvement> of a journal to <out> (.txt or .dna), then exit";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "render";
+	tmp.arguments.push_back("dna");
+	tmp.arguments.push_back("width");
+	tmp.arguments.push_back("height");
+	tmp.arguments.push_back("out");
+	tmp.description = "draw a DNA evolved on the input at <width> x <height> to <out> (.ppm or .qoi), then exit";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "checkpoint";
+	tmp.description = "save the full run state to <input>.checkpoint with each snapshot";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "resume";
+	tmp.arguments.push_back("checkpoint");
+	tmp.description = "continue the run saved in a checkpoint of the same input, with the options it was saved with";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "w";
+	tmp.arguments.push_back("weights");
+	tmp.description = "weight each pixel's error by the brightness of this image (same size as the input), implies -guided";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "bench";
+	tmp.arguments.push_back("fitness");
+	tmp.arguments.push_back("seconds");
+	tmp.description = "compare time to <fitness> (percent) of each -init strategy, at most <seconds> each";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "grow";
+	tmp.arguments.push_back("polygons");
+	tmp.arguments.push_back("vertices");
+	tmp.description = "add and remove polygons and vertices, up to <polygons> and <vertices> per polygon";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
+	tmp.command = "tiles";
+	tmp.arguments.push_back("MB");
+	tmp.description = "stream a large ppm input through a tile file, keeping about <MB> of it in memory (-console, saves DNA only)";
+	arg_data.push_back(tmp);
+	tmp = empty_arg_data;
+
 	if (argc < 2) {
 		helpMenu(arg_data);
 		return;
@@ -227,9 +472,236 @@ arg_parser::arg_parser(const int argc, char** argv) {
 			}
 			logPath = (*it).arguments.front();
 		}
+		else if ((*it).command == "threads") {
+			if ((*it).arguments.size() != 1) {
+				std::cout << "Expecting one argument for -threads" << std::endl;
+				continue;
+			}
+			if (FileHelper::isUInt((*it).arguments.front()) && std::atoi((*it).arguments.front().c_str()) > 0) {
+				threadCount = std::atoi((*it).arguments.front().c_str());
+			}
+			else {
+				std::cout << "Invalid number for -threads" << std::endl;
+			}
+		}
+		else if ((*it).command == "pin") {
+			pinThreads = true;
+		}
+		else if ((*it).command == "prescreen") {
+			if ((*it).arguments.size() != 2) {
+				std::cout << "Expecting two arguments for -prescreen" << std::endl;
+				continue;
+			}
+			auto it2 = (*it).arguments.cbegin();
+			if (!FileHelper::isUInt(*it2) || std::atoi((*it2).c_str()) < 1) {
+				std::cout << "Invalid number for -prescreen" << std::endl;
+				continue;
+			}
+			const int stride = std::atoi((*it2).c_str());
+			++it2;
+			if (!FileHelper::isSimpleFloat(*it2)) {
+				std::cout << "Invalid margin for -prescreen" << std::endl;
+				continue;
+			}
+			prescreenStride = stride;
+			prescreenMargin = static_cast<float>(std::atof((*it2).c_str()));
+		}
+		else if ((*it).command == "seed") {
+			if ((*it).arguments.size() != 1) {
+				std::cout << "Expecting one argument for -seed" << std::endl;
+				continue;
+			}
+			if (FileHelper::isUInt((*it).arguments.front())) {
+				seed = std::strtoull((*it).arguments.front().c_str(), nullptr, 10);
+				seeded = true;
+			}
+			else {
+				std::cout << "Invalid number for -seed" << std::endl;
+			}
+		}
+		else if ((*it).command == "adaptive") {
+			adaptive = true;
+		}
+		else if ((*it).command == "init") {
+			if ((*it).arguments.size() != 1) {
+				std::cout << "Expecting one argument for -init" << std::endl;
+				continue;
+			}
+			const InitStrategy s = stringToInitStrategy((*it).arguments.front());
+			if (s == InitStrategy::NONE)
+				std::cout << "Invalid strategy for -init" << std::endl;
+			else
+				init = s;
+		}
+		else if ((*it).command == "w") {
+			if ((*it).arguments.size() != 1) {
+				std::cout << "Expecting one argument for -w" << std::endl;
+				continue;
+			}
+			weightPath = (*it).arguments.front();
+		}
+		else if ((*it).command == "metric") {
+			if ((*it).arguments.size() != 1) {
+				std::cout << "Expecting one argument for -metric" << std::endl;
+				continue;
+			}
+			const Metric m = stringToMetric((*it).arguments.front());
+			if (m == Metric::NONE)
+				std::cout << "Invalid metric for -metric" << std::endl;
+			else
+				metric = m;
+		}
+		else if ((*it).command == "format") {
+			if ((*it).arguments.size() != 1) {
+				std::cout << "Expecting one argument for -format" << std::endl;
+				continue;
+			}
+			const ImageFormat f = extensionToImageFormat((*it).arguments.front());
+			if (f == ImageFormat::NONE)
+				std::cout << "Invalid format for -format" << std::endl;
+			else
+				saveFormat = f;
+		}
+		else if ((*it).command == "dnaformat") {
+			if ((*it).arguments.size() != 1) {
+				std::cout << "Expecting one argument for -dnaformat" << std::endl;
+				continue;
+			}
+			const DNAFormat f = extensionToDNAFormat((*it).arguments.front());
+			if (f == DNAFormat::NONE)
+				std::cout << "Invalid format for -dnaformat" << std::endl;
+			else
+				dnaFormat = f;
+		}
+		else if ((*it).command == "convert") {
+			if ((*it).arguments.size() != 2) {
+				std::cout << "Expecting two arguments for -convert" << std::endl;
+				continue;
+			}
+			convertIn = (*it).arguments.front();
+			convertOut = (*it).arguments.back();
+		}
+		else if ((*it).command == "journal") {
+			if ((*it).arguments.size() != 1) {
+				std::cout << "Expecting one argument for -journal" << std::endl;
+				continue;
+			}
+			if (FileHelper::isUInt((*it).arguments.front()) && std::atoi((*it).arguments.front().c_str()) > 0)
+				journalInterval = std::atoi((*it).arguments.front().c_str());
+			else
+				std::cout << "Invalid interval for -journal" << std::endl;
+		}
+		else if ((*it).command == "replay") {
+			if ((*it).arguments.size() != 3) {
+				std::cout << "Expecting three arguments for -replay" << std::endl;
+				continue;
+			}
+			auto it2 = (*it).arguments.cbegin();
+			const std::string path = *it2++;
+			if (!FileHelper::isUInt(*it2)) {
+				std::cout << "Invalid improvement for -replay" << std::endl;
+				continue;
+			}
+			replayImp = std::atoi((*it2++).c_str());
+			replayPath = path;
+			replayOut = *it2;
+		}
+		else if ((*it).command == "render") {
+			if ((*it).arguments.size() != 4) {
+				std::cout << "Expecting four arguments for -render" << std::endl;
+				continue;
+			}
+			auto it2 = (*it).arguments.cbegin();
+			const std::string path = *it2++;
+			const std::string w = *it2++;
+			const std::string h = *it2++;
+			if (!FileHelper::isUInt(w) || !FileHelper::isUInt(h) || std::atoi(w.c_str()) < 1 || std::atoi(h.c_str()) < 1) {
+				std::cout << "Invalid size for -render" << std::endl;
+				continue;
+			}
+			renderPath = path;
+			renderWidth = std::atoi(w.c_str());
+			renderHeight = std::atoi(h.c_str());
+			renderOut = *it2;
+		}
+		else if ((*it).command == "checkpoint") {
+			checkpoints = true;
+		}
+		else if ((*it).command == "resume") {
+			if ((*it).arguments.size() != 1) {
+				std::cout << "Expecting one argument for -resume" << std::endl;
+				continue;
+			}
+			resumePath = (*it).arguments.front();
+		}
+		else if ((*it).command == "bench") {
+			if ((*it).arguments.size() != 2) {
+				std::cout << "Expecting two arguments for -bench" << std::endl;
+				continue;
+			}
+			auto it2 = (*it).arguments.cbegin();
+			if (!FileHelper::isSimpleFloat(*it2)) {
+				std::cout << "Invalid fitness for -bench" << std::endl;
+				continue;
+			}
+			const float target = static_cast<float>(std::atof((*it2).c_str()));
+			++it2;
+			if (!FileHelper::isUInt(*it2) || std::atoi((*it2).c_str()) < 1) {
+				std::cout << "Invalid seconds for -bench" << std::endl;
+				continue;
+			}
+			benchFitness = target;
+			benchSeconds = std::atoi((*it2).c_str());
+		}
+		else if ((*it).command == "grow") {
+			if ((*it).arguments.size() != 2) {
+				std::cout << "Expecting two arguments for -grow" << std::endl;
+				continue;
+			}
+			auto it2 = (*it).arguments.cbegin();
+			if (!FileHelper::isUInt(*it2) || std::atoi((*it2).c_str()) < 1) {
+				std::cout << "Invalid polygon count for -grow" << std::endl;
+				continue;
+			}
+			const int polys = std::atoi((*it2).c_str());
+			++it2;
+			if (!FileHelper::isUInt(*it2) || std::atoi((*it2).c_str()) < 3) {
+				std::cout << "Invalid vertex count for -grow" << std::endl;
+				continue;
+			}
+			growPolygons = polys;
+			growVertices = std::atoi((*it2).c_str());
+		}
+		else if ((*it).command == "guided") {
+			guided = true;
+		}
+		else if ((*it).command == "pyramid") {
+			if ((*it).arguments.size() != 1) {
+				std::cout << "Expecting one argument for -pyramid" << std::endl;
+				continue;
+			}
+			if (FileHelper::isUInt((*it).arguments.front())) {
+				pyramidLevels = std::atoi((*it).arguments.front().c_str());
+			}
+			else {
+				std::cout << "Invalid number for -pyramid" << std::endl;
+			}
+		}
+		else if ((*it).command == "tiles") {
+			if ((*it).arguments.size() != 1) {
+				std::cout << "Expecting one argument for -tiles" << std::endl;
+				continue;
+			}
+			if (FileHelper::isUInt((*it).arguments.front()) && std::atoi((*it).arguments.front().c_str()) > 0) {
+				tileBudget = std::atoi((*it).arguments.front().c_str());
+			}
+			else {
+				std::cout << "Invalid size for -tiles" << std::endl;
+			}
+		}
 	}
 
-	valid = !imgPath.empty();
+	valid = !imgPath.empty() || !convertOut.empty() || !replayOut.empty();
 	if (!valid) {
 		std::cout << "Missing argument -i" << std::endl;
 	}
@@ -239,6 +711,18 @@ arg_parser::arg_parser(const int argc, char** argv) {
 void arg_parser::execute() {
 	if (!valid)
 		return;
+	if (!convertOut.empty()) {
+		convert();
+		return;
+	}
+	if (!replayOut.empty()) {
+		replay();
+		return;
+	}
+	if (!renderOut.empty()) {
+		render();
+		return;
+	}
 
 	std::streambuf* buf = std::cout.rdbuf();
 	std::ofstream logFile;
@@ -255,28 +739,119 @@ void arg_parser::execute() {
 	}
 	std::ostream saveStream{buf};
 
-	ir.read(imgPath);
-	orig = ir.getImage();
-	if (orig.empty()) {
-		std::cout << "Error reading image: " << ir.getError() << std::endl;
+	// quadrants are drawn as rectangles
+	if (init == InitStrategy::QUADTREE && vertCount < 4) {
+		std::cout << "-init quadtree needs at least 4 vertices per polygon (-v)" << std::endl;
 		return;
 	}
 
-	if (dnaPath.empty()) {
-		ii = new img_iter(orig, polyCount, vertCount);
+	// the tiled input is never loaded whole
+	FileHelper::PPMRows rows;
+	if (tileBudget > 0) {
+		if (program_mode != ProgramMode::CONSOLE || !weightPath.empty() || checkpoints || !resumePath.empty() ||
+		    benchSeconds > 0 || init != InitStrategy::RANDOM || pyramidLevels > 0) {
+			std::cout << "-tiles needs -console and does not support -w, -checkpoint, -resume, -bench, -init or -pyramid" << std::endl;
+			return;
+		}
+		if (!rows.open(imgPath)) {
+			std::cout << "Error reading image: " << rows.getError() << std::endl;
+			return;
+		}
 	}
 	else {
+		ir.read(imgPath);
+		orig = ir.getImage();
+		if (orig.empty()) {
+			std::cout << "Error reading image: " << ir.getError() << std::endl;
+			return;
+		}
+	}
+
+	if (!weightPath.empty()) {
+		ir.read(weightPath);
+		weights = ir.getImage();
+		if (weights.empty()) {
+			std::cout << "Error reading weights: " << ir.getError() << std::endl;
+			return;
+		}
+		if (weights.width() != orig.width() || weights.height() != orig.height()) {
+			std::cout << "Weights must be the size of the image" << std::endl;
+			return;
+		}
+	}
+
+	if (!seeded) {
+		std::random_device rd;
+		seed = (static_cast<std::uint64_t>(rd()) << 32) | rd();
+	}
+	if (resumePath.empty())
+		saveStream << "Seed: " << seed << std::endl;
+	if (tileBudget == 0 && img_iter::monochrome(orig))
+		saveStream << "Monochrome: scoring one channel" << std::endl;
+
+	TaskScheduler scheduler{threadCount, pinThreads};
+	if (benchSeconds > 0) {
+		bench(orig, scheduler, saveStream);
+		return;
+	}
+	DNA dna;
+	if (!resumePath.empty()) {
+		std::string resumeError;
+		ii = img_iter::resume(orig, resumePath, scheduler, resumeError);
+		if (ii == nullptr) {
+			std::cout << "Error reading checkpoint: " << resumeError << std::endl;
+			return;
+		}
+		saveStream << "Resumed at improvement " << ii->improvements()
+		           << " (run options are the checkpoint's)" << std::endl;
+	}
+	else if (!dnaPath.empty()) {
 		std::string dnaReadError;
-		DNA dna{readDNA(dnaPath, dnaReadError)};
+		dna = readDNA(dnaPath, dnaReadError);
 		if (!dnaReadError.empty()) {
 			std::cout << "Error reading DNA: " << dnaReadError << std::endl;
 			return;
 		}
-		ii = new img_iter(orig, dna);
+	}
+	if (ii == nullptr && dna.empty() && init != InitStrategy::RANDOM) {
+		Initializer initializer{orig, vertCount, seed};
+		dna = initializer.make(init, polyCount);
+	}
+	if (ii == nullptr && pyramidLevels > 0) {
+		auto cfg = [this] (img_iter& level, const Image& w) {
+			configure(level, w);
+		};
+		pyramid_seeder ps{orig, weights, pyramidLevels, scheduler, seed, cfg, saveStream};
+		dna = dna.empty() ? ps.seed(polyCount, vertCount) : ps.seed(dna);
+	}
+
+	if (ii == nullptr && tileBudget > 0) {
+		std::string tileError;
+		ii = img_iter::createTiled(rows, imgPath, static_cast<std::size_t>(tileBudget) << 20, dna, polyCount, vertCount, scheduler, seed, tileError);
+		if (ii == nullptr) {
+			std::cout << "Error tiling image: " << tileError << std::endl;
+			return;
+		}
+		configure(*ii, weights);
+	}
+	if (ii == nullptr) {
+		if (dna.empty())
+			ii = img_iter::create(orig, polyCount, vertCount, scheduler, seed);
+		else
+			ii = img_iter::create(orig, dna, scheduler, seed);
+		configure(*ii, weights);
+	}
+	Journal journal;
+	if (journalInterval > 0) {
+		if (journal.open(imgPath + ".journal", journalInterval))
+			ii->setJournal(&journal);
+		else
+			std::cout << "Error opening journal" << std::endl;
 	}
 
 	// run
-	img_iter_saver iis{imgPath, ImageFormat::PPM, *ii, save_option, save_option_number, saveStream};
+	img_iter_saver iis{imgPath, saveFormat, dnaFormat, *ii, save_option, save_option_number, saveStream};
+	iis.setCheckpoints(checkpoints);
 	if (program_mode == ProgramMode::VIEWER) {
 		Viewer viewer{orig, ii->bestImage()};
 		if (viewer.hasError())
@@ -334,3 +909,140 @@ bool arg_parser::validCommand(const std::string& command, const std::list<argume
 	}
 	return false;
 }
+
+
+// options for the run, w is weights or a downsampled copy (empty if unweighted)
+void arg_parser::configure(img_iter& ii, const Image& w) const {
+	ii.setMetric(metric);
+	if (!w.empty() && !ii.setWeights(w))
+		std::cout << "Ignoring weights: all black" << std::endl;
+	ii.setPrescreen(prescreenStride, prescreenMargin);
+	ii.setGuided(guided);
+	ii.setAdaptive(adaptive);
+	ii.setGrowth(growPolygons, growVertices);
+}
+
+
+// reads convertIn in either DNA format, writes convertOut in the format of its extension
+void arg_parser::convert() const {
+	const DNAFormat format = dnaFormatOf(convertOut);
+	if (format == DNAFormat::NONE) {
+		std::cout << "Output of -convert must end in .txt or .dna" << std::endl;
+		return;
+	}
+	std::string error;
+	const DNA dna = readDNA(convertIn, error);
+	if (!error.empty()) {
+		std::cout << "Error reading DNA: " << error << std::endl;
+		return;
+	}
+	if (!writeDNA(dna, convertOut, format))
+		std::cout << "Error writing DNA" << std::endl;
+}
+
+
+// writes the DNA of journal replayPath at improvement replayImp to replayOut
+void arg_parser::replay() const {
+	const DNAFormat format = dnaFormatOf(replayOut);
+	if (format == DNAFormat::NONE) {
+		std::cout << "Output of -replay must end in .txt or .dna" << std::endl;
+		return;
+	}
+	std::string error;
+	int reached = 0;
+	const DNA dna = Journal::replay(replayPath, replayImp, reached, error);
+	if (!error.empty()) {
+		std::cout << "Error reading journal: " << error << std::endl;
+		return;
+	}
+	if (reached < replayImp)
+		std::cout << "Journal ends at improvement " << reached << std::endl;
+	if (!writeDNA(dna, replayOut, format))
+		std::cout << "Error writing DNA" << std::endl;
+}
+
+
+// draws the DNA at renderPath at renderWidth x renderHeight to renderOut, its
+// vertices scaled from the size of the input (only the header of a ppm is read)
+void arg_parser::render() const {
+	const std::string::size_type extIndex = renderOut.rfind('.');
+	const ImageFormat format = extIndex == std::string::npos ? ImageFormat::NONE : extensionToImageFormat(renderOut.substr(extIndex + 1));
+	if (format == ImageFormat::NONE) {
+		std::cout << "Output of -render must end in .ppm or .qoi" << std::endl;
+		return;
+	}
+	int w;
+	int h;
+	FileHelper::PPMRows rows;
+	if (rows.open(imgPath)) {
+		w = rows.width();
+		h = rows.height();
+	}
+	else {
+		ImageReader ir;
+		ir.read(imgPath);
+		const Image img{ir.getImage()};
+		if (img.empty()) {
+			std::cout << "Error reading image: " << ir.getError() << std::endl;
+			return;
+		}
+		w = img.width();
+		h = img.height();
+	}
+	std::string error;
+	const DNA dna = readDNA(renderPath, error);
+	if (!error.empty()) {
+		std::cout << "Error reading DNA: " << error << std::endl;
+		return;
+	}
+	TaskScheduler scheduler{threadCount, pinThreads};
+	Renderer r{dna, w, h, renderWidth, renderHeight};
+	if (r.hasError()) {
+		std::cout << "Error reading image: no pixels" << std::endl;
+		return;
+	}
+	if (!r.render(renderOut, format, scheduler))
+		std::cout << "Error writing image" << std::endl;
+}
+
+
+// DNA format by the extension of path
+DNAFormat arg_parser::dnaFormatOf(const std::string& path) {
+	const std::string::size_type extIndex = path.rfind('.');
+	if (extIndex == std::string::npos)
+		return DNAFormat::NONE;
+	return extensionToDNAFormat(path.substr(extIndex + 1));
+}
+
+
+// run each init strategy with the same seed and options until fitness reaches
+// benchFitness or benchSeconds pass
+void arg_parser::bench(const Image& orig, TaskScheduler& scheduler, std::ostream& os) const {
+	typedef std::chrono::steady_clock Clock;
+	const InitStrategy strategies[] = {InitStrategy::RANDOM, InitStrategy::SIMPLE, InitStrategy::QUADTREE, InitStrategy::KMEANS};
+	for (auto it = std::begin(strategies); it != std::end(strategies); ++it) {
+		if (*it == InitStrategy::QUADTREE && vertCount < 4)
+			continue;	// see execute()
+		const Clock::time_point start = Clock::now();
+		auto elapsed = [&start] () {
+			return std::chrono::duration<double>(Clock::now() - start).count();
+		};
+		Initializer initializer{orig, vertCount, seed};
+		img_iter* ii = img_iter::create(orig, initializer.make(*it, polyCount), scheduler, seed);
+		configure(*ii, weights);
+		const float initFit = ii->fitness();
+		const double initTime = elapsed();
+		while (ii->fitness() * 100 < benchFitness && elapsed() < benchSeconds)
+			ii->iterate();
+		os << "Init: " << std::setw(8) << InitStrategyToString(*it)
+		   << "\tStart fit: " << initFit * 100 << " (" << initTime << " s)";
+		if (ii->fitness() * 100 >= benchFitness)
+			os << "\tReached " << benchFitness << " in " << elapsed() << " s";
+		else
+			os << "\tNot reached in " << benchSeconds << " s";
+		os << "\tFit: " << ii->fitness() * 100
+		   << "\tIter: " << ii->iterations()
+		   << "\tImp: " << ii->improvements() << std::endl;
+		delete ii;
+	}
+}
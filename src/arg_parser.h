@@ -2,38 +2,89 @@
 
 #include "file_helper.h"
 #include "img_iter.h"
+#include "initializer.h"
+#include "pyramid.h"
+#include "renderer.h"
+#include "task_scheduler.h"
 #include "viewer.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
+#include <thread>
+#include <vector>
 
 
 enum class SaveOption {ITERATIONS, IMPROVEMENTS};
 enum class ProgramMode {VIEWER, CONSOLE};
 
 
+// Snapshots are taken on the iteration thread and written by a background
+// thread. Taking one copies the DNA and shares the tiles of the best image
+// (see img_iter::snapshot), so its cost does not grow with the image; the
+// writer converts, encodes and serializes the pixels. At most queueSize
+// snapshots wait; when the disk falls behind the newest waiting snapshot is
+// replaced, so the latest state is always written and the skipped ones are
+// counted as dropped. With checkpoints enabled each snapshot also carries the
+// engine state, completed with the pixels and written to <image>.checkpoint.
+// Tiled runs save the DNA only.
 class img_iter_saver {
 public:
-	img_iter_saver(const std::string&, const ImageFormat, const img_iter&, SaveOption, int, std::ostream&);
-	~img_iter_saver() = default;
+	img_iter_saver(const std::string&, const ImageFormat, const DNAFormat, const img_iter&, SaveOption, int, std::ostream&);
+	img_iter_saver(const img_iter_saver&) = delete;
+	~img_iter_saver();
+	img_iter_saver& operator=(const img_iter_saver&) = delete;
 	void update(void);
 	void save(void);
+	void setCheckpoints(const bool);
 private:
+	struct Snapshot {
+		std::unique_ptr<ImageSnapshot> img;	// null if tiled
+		DNA dna;
+		CheckpointWriter checkpoint;	// engine state, completed by img
+		bool checkpointed = false;
+		std::string imgPath;
+		std::string dnaPath;
+	};
+
 	bool check(void) const;
 	std::string saveImgPath(void) const;
 	std::string saveDNAPath(void) const;
+	void writeLoop(void);
+	void reportErrors(void);
 	static constexpr int padSize = 7;
+	static constexpr std::size_t queueSize = 2;
 	const img_iter& ii;
 	const SaveOption so;
 	const int optNum;
 	const std::string imgPath;
 	const ImageFormat saveFormat;
 	const std::string saveExt;
+	const DNAFormat dnaFormat;
+	const std::string dnaExt;
 	int last = 0;
-	ImageWriter iw;
+	int dropped = 0;
+	bool checkpoints = false;
+	const std::string checkpointPath;
+	ImageWriter iw;	// used by the writer thread only
+	std::vector<Color> row;	// used by the writer thread only
 	std::ostream& os;
+
+	std::deque<Snapshot> pending;
+	std::mutex queueMutex;
+	std::condition_variable queueCV;
+	bool stop = false;
+	int checkpointErrors = 0;	// failed writes not yet reported to os
+	std::thread writer;
 };
 
 
@@ -53,12 +104,50 @@ public:
 private:
 	void helpMenu(const std::list<argument_data>&);
 	static bool validCommand(const std::string&, const std::list<argument_data>&);
+	void configure(img_iter&, const Image&) const;
+	void bench(const Image&, TaskScheduler&, std::ostream&) const;
+	void convert(void) const;
+	void replay(void) const;
+	void render(void) const;
+	static DNAFormat dnaFormatOf(const std::string&);
 	std::string imgPath;
 	std::string dnaPath;
 	std::string logPath;
+	std::string weightPath;
 	int polyCount = 50;
 	int vertCount = 6;
 	int save_option_number = 100;
+	int threadCount = 1;
+	int pyramidLevels = 0;
+	int tileBudget = 0;	// MB of resident tiles, 0 loads the image
+	int prescreenStride = 0;
+	float prescreenMargin = 0;
+	bool guided = false;
+	bool adaptive = false;
+	int growPolygons = 0;	// 0 keeps counts fixed
+	int growVertices = 0;
+	InitStrategy init = InitStrategy::RANDOM;
+	Metric metric = Metric::SAD;
+	Image weights;	// read from weightPath
+	ImageFormat saveFormat = ImageFormat::PPM;
+	DNAFormat dnaFormat = DNAFormat::TEXT;
+	std::string convertIn;	// -convert DNA paths
+	std::string convertOut;
+	int journalInterval = 0;	// 0 disables the journal
+	bool checkpoints = false;	// write <input>.checkpoint at each save
+	std::string resumePath;	// -resume checkpoint
+	std::string replayPath;	// -replay journal, improvement, DNA path
+	int replayImp = 0;
+	std::string replayOut;
+	std::string renderPath;	// -render DNA, size, output path
+	int renderWidth = 0;
+	int renderHeight = 0;
+	std::string renderOut;
+	float benchFitness = 0;	// percent
+	int benchSeconds = 0;	// 0 runs normally
+	std::uint64_t seed = 0;
+	bool seeded = false;	// seed given
+	bool pinThreads = false;
 	SaveOption save_option = SaveOption::IMPROVEMENTS;
 	ProgramMode program_mode = ProgramMode::VIEWER;
 	bool valid = false;
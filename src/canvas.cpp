@@ -1,28 +1,39 @@
 #include "canvas.h"
 
 
-Canvas::Canvas(const int w, const int h)
+template <class Pixel>
+BasicCanvas<Pixel>::BasicCanvas(const int w, const int h)
 : WIDTH(w), HEIGHT(h) {
-	colors = new Color*[h];
+	colors = new Pixel*[h];
 	for (int i = 0; i < h; ++i)
-		colors[i] = new Color[w];
+		colors[i] = new Pixel[w];
 
 }
 
 
-Canvas::Canvas(const Image& img)
-: Canvas(img.width(), img.height()) {
+template <class Pixel>
+BasicCanvas<Pixel>::BasicCanvas(const BasicImage<Pixel>& img)
+: BasicCanvas(img.width(), img.height()) {
 	for (int x = 0; x < WIDTH; ++x) {
-		for (int y = 0; y < HEIGHT; ++y) {
-			setColor(img.get(x, y));
-			drawPoint(x, y);
-		}
+		for (int y = 0; y < HEIGHT; ++y)
+			setPoint(x, y, img.get(x, y));
 	}
 }
 
 
-Canvas::~Canvas() {
-	for (int i = 0; i < HEIGHT; ++i) {
+// window r of a larger image, drawn into data
+template <class Pixel>
+BasicCanvas<Pixel>::BasicCanvas(Pixel* data, const int stride, const Rectangle& r)
+: WIDTH(r.x1 - r.x0 + 1), HEIGHT(r.y1 - r.y0 + 1), originX(r.x0), originY(r.y0), window(true) {
+	colors = new Pixel*[HEIGHT];
+	for (int i = 0; i < HEIGHT; ++i)
+		colors[i] = data + i * stride;
+}
+
+
+template <class Pixel>
+BasicCanvas<Pixel>::~BasicCanvas() {
+	for (int i = 0; i < HEIGHT && !window; ++i) {
 		delete[] colors[i];
 		colors[i] = nullptr;
 	}
@@ -31,19 +42,23 @@ Canvas::~Canvas() {
 }
 
 
-void Canvas::setColor(const Color& c) {
+template <class Pixel>
+void BasicCanvas<Pixel>::setColor(const Color& c) {
 	brushColor = c;
+	brush = Pixel(c);
 }
 
 
-void Canvas::setAlpha(const float a) {
+template <class Pixel>
+void BasicCanvas<Pixel>::setAlpha(const float a) {
 	if (a >= 0 && a <= 1)
 		alpha = a;
 }
 
 
-Image Canvas::getImage() const {
-	Image img{WIDTH, HEIGHT};
+template <class Pixel>
+BasicImage<Pixel> BasicCanvas<Pixel>::getImage() const {
+	BasicImage<Pixel> img{WIDTH, HEIGHT};
 	for (int x = 0; x < WIDTH; ++x) {
 		for (int y = 0; y < HEIGHT; ++y)
 			img.set(x, y, getPoint(x, y));
@@ -52,28 +67,40 @@ Image Canvas::getImage() const {
 }
 
 
-Color& Canvas::getPoint(const int x, const int y) {
+template <class Pixel>
+Pixel& BasicCanvas<Pixel>::getPoint(const int x, const int y) {
 	return colors[y][x];
 }
 
 
-Color Canvas::getPoint(const int x, const int y) const {
+template <class Pixel>
+Pixel BasicCanvas<Pixel>::getPoint(const int x, const int y) const {
 	return colors[y][x];
 }
 
 
-void Canvas::setPoint(const int x, const int y, const Color& c) {
-	Color& color = getPoint(x, y);
+// contiguous pixels of row y (unchecked)
+template <class Pixel>
+const Pixel* BasicCanvas<Pixel>::row(const int y) const {
+	return colors[y];
+}
+
+
+template <class Pixel>
+void BasicCanvas<Pixel>::setPoint(const int x, const int y, const Pixel& c) {
+	Pixel& color = getPoint(x, y);
 	color = c;
 }
 
 
-void Canvas::drawPoint(const int x, const int y) {
-	getPoint(x, y).blend(brushColor, alpha);
+template <class Pixel>
+void BasicCanvas<Pixel>::drawPoint(const int x, const int y) {
+	getPoint(x, y).blend(brush, alpha);
 }
 
 
-void Canvas::drawLine(const int x0, const int y0, const int x1, const int y1) {
+template <class Pixel>
+void BasicCanvas<Pixel>::drawLine(const int x0, const int y0, const int x1, const int y1) {
 	const int dx = std::abs(x1 - x0);
 	const int dy = std::abs(y1 - y0);
 	const int sx = x0 < x1 ? 1 : -1;
@@ -99,7 +126,8 @@ void Canvas::drawLine(const int x0, const int y0, const int x1, const int y1) {
 }
 
 
-void Canvas::drawRect(const int x, const int y, const int w, const int h) {
+template <class Pixel>
+void BasicCanvas<Pixel>::drawRect(const int x, const int y, const int w, const int h) {
 	int cx = x;
 	int cy = y;
 	// top
@@ -117,7 +145,8 @@ void Canvas::drawRect(const int x, const int y, const int w, const int h) {
 }
 
 
-void Canvas::draw(const Polygon& p) {
+template <class Pixel>
+void BasicCanvas<Pixel>::draw(const Polygon& p) {
 	auto& vert = p.vertices();
 	auto it = vert.cbegin();
 	int prevX = (*it).x;
@@ -132,21 +161,19 @@ void Canvas::draw(const Polygon& p) {
 }
 
 
-void Canvas::draw(const Image& img) {
+template <class Pixel>
+void BasicCanvas<Pixel>::draw(const BasicImage<Pixel>& img) {
 	const int xLim = img.width() > WIDTH ? WIDTH : img.width();
 	const int yLim = img.height() > HEIGHT ? HEIGHT : img.height();
-	Color oldColor{brushColor};
 	for (int x = 0; x < xLim; ++x) {
-		for (int y = 0; y < yLim; ++y) {
-			setColor(img.get(x, y));
-			drawPoint(x, y);
-		}
+		for (int y = 0; y < yLim; ++y)
+			getPoint(x, y).blend(img.get(x, y), alpha);
 	}
-	setColor(oldColor);
 }
 
 
-void Canvas::fill(const Polygon& p) {
+template <class Pixel>
+void BasicCanvas<Pixel>::fill(const Polygon& p) {
 	const auto& lines = p.fillDetails();
 	bool draw;
 	int x = 0;	// default value
@@ -162,16 +189,36 @@ void Canvas::fill(const Polygon& p) {
 }
 
 
-void Canvas::fill(const Rectangle& r) {
-	for (int y = r.y0; y <= r.y1; ++y)
-		drawLineH(r.x0, y, r.x1);
+template <class Pixel>
+void BasicCanvas<Pixel>::fill(const Rectangle& r) {
+	fill(r, brushColor, alpha);
 }
 
 
 // fill intersection of polygon and mask
-void Canvas::fill(const Polygon& p, const Rectangle& mask) {
+template <class Pixel>
+void BasicCanvas<Pixel>::fill(const Polygon& p, const Rectangle& mask) {
+	fill(p, mask, brushColor, alpha);
+}
+
+
+// like fill(const Rectangle&), but does not use brush state
+// (safe to call concurrently on disjoint rectangles)
+template <class Pixel>
+void BasicCanvas<Pixel>::fill(const Rectangle& r, const Color& c, const float a) {
+	const Pixel px{c};
+	for (int y = r.y0; y <= r.y1; ++y)
+		drawLineH(r.x0, y, r.x1, px, a);
+}
+
+
+// like fill(const Polygon&, const Rectangle&), but does not use brush state
+// polygon fill details must already be cached when called concurrently
+template <class Pixel>
+void BasicCanvas<Pixel>::fill(const Polygon& p, const Rectangle& mask, const Color& c, const float a) {
 	const auto& lines = p.fillDetails();
 	assert(!lines.empty());
+	const Pixel px{c};
 
 	unsigned int i = mask.y0 <= lines.front().y ? 0 : mask.y0 - lines.front().y;
 	unsigned int iHi = std::min(i + (mask.y1 - lines[i].y), lines.size() - 1);
@@ -200,7 +247,7 @@ void Canvas::fill(const Polygon& p, const Rectangle& mask) {
 				if (!((x > mask.x1) || (*it < mask.x0))) {
 					drawLeft = std::max(x, mask.x0);
 					drawRight = std::min(*it, mask.x1);
-					drawLineH(drawLeft, lines[i].y, drawRight);
+					drawLineH(drawLeft, lines[i].y, drawRight, px, a);
 				}
 			}
 			else {
@@ -211,7 +258,8 @@ void Canvas::fill(const Polygon& p, const Rectangle& mask) {
 }
 
 
-void Canvas::clear() {
+template <class Pixel>
+void BasicCanvas<Pixel>::clear() {
 	for (int x = 0; x < WIDTH; ++x) {
 		for (int y = 0; y < HEIGHT; ++y)
 			drawPoint(x, y);
@@ -219,26 +267,31 @@ void Canvas::clear() {
 }
 
 
-void Canvas::clear(const Color& c) {
+template <class Pixel>
+void BasicCanvas<Pixel>::clear(const Color& c) {
+	const Pixel px{c};
 	for (int x = 0; x < WIDTH; ++x) {
 		for (int y = 0; y < HEIGHT; ++y)
-			setPoint(x, y, c);
+			setPoint(x, y, px);
 	}
 }
 
 
-int Canvas::width() const {
+template <class Pixel>
+int BasicCanvas<Pixel>::width() const {
 	return WIDTH;
 }
 
 
-int Canvas::height() const {
+template <class Pixel>
+int BasicCanvas<Pixel>::height() const {
 	return HEIGHT;
 }
 
 
 // like drawLine() but doesn't draw last pixel (for drawing connected lines)
-void Canvas::drawLine2(const int x0, const int y0, const int x1, const int y1) {
+template <class Pixel>
+void BasicCanvas<Pixel>::drawLine2(const int x0, const int y0, const int x1, const int y1) {
 	const int dx = std::abs(x1 - x0);
 	const int dy = std::abs(y1 - y0);
 	const int sx = x0 < x1 ? 1 : -1;
@@ -266,13 +319,27 @@ void Canvas::drawLine2(const int x0, const int y0, const int x1, const int y1) {
 
 
 // draw a horizontal line
-void Canvas::drawLineH(const int x0, const int y, const int x1) {
+template <class Pixel>
+void BasicCanvas<Pixel>::drawLineH(const int x0, const int y, const int x1) {
 	for (int x = x0; x <= x1; ++x)
 		drawPoint(x, y);
 }
 
 
-void Canvas::drawLineV(const int x, const int y0, const int y1) {
+template <class Pixel>
+void BasicCanvas<Pixel>::drawLineH(const int x0, const int y, const int x1, const Pixel& c, const float a) {
+	Pixel* row = colors[y - originY];
+	for (int x = x0 - originX; x <= x1 - originX; ++x)
+		row[x].blend(c, a);
+}
+
+
+template <class Pixel>
+void BasicCanvas<Pixel>::drawLineV(const int x, const int y0, const int y1) {
 	for (int y = y0; y <= y1; ++y)
 		drawPoint(x, y);
 }
+
+
+template class BasicCanvas<Color>;
+template class BasicCanvas<Gray8>;
@@ -7,11 +7,18 @@
 #include <cmath>
 
 
-class Canvas {
+// Pixel is Color (RGB) or Gray8, instantiated in canvas.cpp. Colors drawn
+// are converted to Pixel once per call.
+// A window canvas draws a rectangle of a larger image into a caller's buffer
+// (rows stride pixels apart). Its fill functions that take a color take
+// coordinates of the larger image; the others are for whole canvases only.
+template <class Pixel>
+class BasicCanvas {
 public:
-	Canvas(const int, const int);
-	Canvas(const Image&);
-	~Canvas();
+	BasicCanvas(const int, const int);
+	BasicCanvas(const BasicImage<Pixel>&);
+	BasicCanvas(Pixel*, const int, const Rectangle&);
+	~BasicCanvas();
 	void setColor(const Color&);
 	void setAlpha(const float);
 	void drawPoint(const int, const int);
@@ -20,26 +27,38 @@ public:
 	void drawEllipse(const int, const int, const int);
 	void fillEllipse(const int, const int, const int);
 	void draw(const Polygon&);
-	void draw(const Image&);
+	void draw(const BasicImage<Pixel>&);
 	void fill(const Rectangle&);
 	void fill(const Polygon&);
 	void fill(const Polygon&, const Rectangle&);
+	void fill(const Rectangle&, const Color&, const float);
+	void fill(const Polygon&, const Rectangle&, const Color&, const float);
 	void clear(void);
 	void clear(const Color&);
-	Image getImage(void) const;
-	Color getPoint(const int, const int) const;
+	BasicImage<Pixel> getImage(void) const;
+	Pixel getPoint(const int, const int) const;
+	const Pixel* row(const int) const;
 	int width(void) const;
 	int height(void) const;
 private:
-	void setPoint(const int, const int, const Color&);
-	Color& getPoint(const int, const int);
+	void setPoint(const int, const int, const Pixel&);
+	Pixel& getPoint(const int, const int);
 	void drawLine2(const int, const int, const int, const int);
 	void drawLineH(const int, const int, const int);
+	void drawLineH(const int, const int, const int, const Pixel&, const float);
 	void drawLineV(const int, const int, const int);
 
 	Color brushColor;
+	Pixel brush;	// brushColor converted
 	float alpha = 1.0;
 	const int WIDTH;
 	const int HEIGHT;
-	Color** colors;
+	const int originX = 0;	// of a window
+	const int originY = 0;
+	const bool window = false;	// rows are not owned
+	Pixel** colors;
 };
+
+
+typedef BasicCanvas<Color> Canvas;
+typedef BasicCanvas<Gray8> GrayCanvas;
@@ -0,0 +1,147 @@
+#include "checkpoint.h"
+
+
+constexpr char CheckpointReader::magic[];
+
+
+CheckpointWriter::CheckpointWriter() {
+	putBytes(CheckpointReader::magic, sizeof(CheckpointReader::magic));
+	put8(CheckpointReader::version);
+	put8(CheckpointReader::version >> 8);
+}
+
+
+void CheckpointWriter::put8(const std::uint8_t v) {
+	buf.push_back(v);
+}
+
+
+void CheckpointWriter::put32(const std::uint32_t v) {
+	for (int i = 0; i < 4; ++i)
+		buf.push_back(v >> (8 * i));
+}
+
+
+void CheckpointWriter::put64(const std::uint64_t v) {
+	put32(v);
+	put32(v >> 32);
+}
+
+
+void CheckpointWriter::putFloat(const float f) {
+	std::uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(f));
+	put32(bits);
+}
+
+
+void CheckpointWriter::putDouble(const double d) {
+	std::uint64_t bits;
+	std::memcpy(&bits, &d, sizeof(d));
+	put64(bits);
+}
+
+
+void CheckpointWriter::putBytes(const void* data, const std::size_t n) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	buf.insert(buf.end(), bytes, bytes + n);
+}
+
+
+// appends the checksum, returns the file contents
+const std::vector<unsigned char>& CheckpointWriter::finish() {
+	put32(FileHelper::checksum(buf.data(), buf.size()));
+	return buf;
+}
+
+
+bool CheckpointReader::open(const std::string& path, std::string& error) {
+	if (!file.open(path)) {
+		error = "unable to open file";
+		return false;
+	}
+	const unsigned char* data = file.data();
+	const std::size_t size = file.size();
+	if (size < sizeof(magic) + 2 + 4 || std::memcmp(data, magic, sizeof(magic)) != 0) {
+		error = "not a checkpoint";
+		return false;
+	}
+	if ((data[4] | data[5] << 8) != version) {
+		error = "unsupported version";
+		return false;
+	}
+	p = data + size - 4;
+	end = data + size;
+	ok = true;
+	if (FileHelper::checksum(data, size - 4) != get32()) {
+		error = "checksum mismatch";
+		ok = false;
+		return false;
+	}
+	p = data + sizeof(magic) + 2;
+	end = data + size - 4;
+	return true;
+}
+
+
+std::uint8_t CheckpointReader::get8() {
+	if (!take(1))
+		return 0;
+	return p[-1];
+}
+
+
+std::uint32_t CheckpointReader::get32() {
+	if (!take(4))
+		return 0;
+	return static_cast<std::uint32_t>(p[-4]) | p[-3] << 8 | p[-2] << 16 | static_cast<std::uint32_t>(p[-1]) << 24;
+}
+
+
+std::uint64_t CheckpointReader::get64() {
+	const std::uint64_t lo = get32();
+	return lo | static_cast<std::uint64_t>(get32()) << 32;
+}
+
+
+float CheckpointReader::getFloat() {
+	const std::uint32_t bits = get32();
+	float f;
+	std::memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+
+double CheckpointReader::getDouble() {
+	const std::uint64_t bits = get64();
+	double d;
+	std::memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+
+void CheckpointReader::getBytes(void* out, const std::size_t n) {
+	if (take(n))
+		std::memcpy(out, p - n, n);
+}
+
+
+bool CheckpointReader::good() const {
+	return ok;
+}
+
+
+bool CheckpointReader::atEnd() const {
+	return p == end;
+}
+
+
+// advances past n bytes if they are there
+bool CheckpointReader::take(const std::size_t n) {
+	if (!ok || static_cast<std::size_t>(end - p) < n) {
+		ok = false;
+		return false;
+	}
+	p += n;
+	return true;
+}
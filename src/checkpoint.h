@@ -0,0 +1,55 @@
+#pragma once
+
+#include "file_helper.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+// Checkpoint file: "IICP" u16 version, the engine state as little-endian
+// values in the order img_iter::checkpoint writes them, then a u32 FNV-1a
+// checksum of all preceding bytes.
+class CheckpointWriter {
+public:
+	CheckpointWriter();
+	void put8(const std::uint8_t);
+	void put32(const std::uint32_t);
+	void put64(const std::uint64_t);
+	void putFloat(const float);
+	void putDouble(const double);
+	void putBytes(const void*, const std::size_t);
+	const std::vector<unsigned char>& finish(void);
+private:
+	std::vector<unsigned char> buf;
+};
+
+
+// Reads values back in the same order. A read past the end returns 0 and
+// clears good(), so loaders check once after a group of reads.
+class CheckpointReader {
+public:
+	CheckpointReader() = default;
+	CheckpointReader(const CheckpointReader&) = delete;
+	CheckpointReader& operator=(const CheckpointReader&) = delete;
+	bool open(const std::string&, std::string&);
+	std::uint8_t get8(void);
+	std::uint32_t get32(void);
+	std::uint64_t get64(void);
+	float getFloat(void);
+	double getDouble(void);
+	void getBytes(void*, const std::size_t);
+	bool good(void) const;
+	bool atEnd(void) const;
+private:
+	bool take(const std::size_t);
+
+	static constexpr char magic[4] = {'I', 'I', 'C', 'P'};
+	static constexpr std::uint16_t version = 1;
+	FileHelper::MappedFile file;
+	const unsigned char* p = nullptr;
+	const unsigned char* end = nullptr;
+	bool ok = false;
+
+	friend class CheckpointWriter;
+};
@@ -13,6 +13,10 @@ Color::Color(const Color& c) : R(c.R), G(c.G), B(c.B) {
 }
 
 
+Color::Color(const Gray8& g) : R(g.V), G(g.V), B(g.V) {
+}
+
+
 Color& Color::operator=(const Color& c) {
 	this->R = c.R;
 	this->G = c.G;
@@ -37,3 +41,21 @@ Color::ColorChannel Color::blend(const ColorChannel cc1, const ColorChannel cc2,
 Color Color::blend(const Color& c1, const Color& c2, const float a) {
 	return Color{blend(c1.R, c2.R, a), blend(c1.G, c2.G, a), blend(c1.B, c2.B, a)};
 }
+
+
+Gray8::Gray8() : V(Color::defColorChannel) {
+}
+
+
+Gray8::Gray8(const Color::ColorChannel v) : V(v) {
+}
+
+
+// luma weights sum to 256, so gray colors keep their value
+Gray8::Gray8(const Color& c) : V(static_cast<Color::ColorChannel>((77 * c.R + 150 * c.G + 29 * c.B) >> 8)) {
+}
+
+
+void Gray8::blend(const Gray8& g, const float a) {
+	V = Color::blend(V, g.V, a);
+}
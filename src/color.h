@@ -1,6 +1,9 @@
 #pragma once
 
 
+class Gray8;
+
+
 class Color {
 public:
 	typedef unsigned char ColorChannel;
@@ -10,6 +13,7 @@ public:
 	Color();
 	Color(ColorChannel, ColorChannel, ColorChannel);
 	Color(const Color&);
+	explicit Color(const Gray8&);
 	~Color() = default;
 	Color& operator=(const Color&);
 	void blend(const Color&, const float);
@@ -20,3 +24,16 @@ public:
 	ColorChannel G;
 	ColorChannel B;
 };
+
+
+// single channel pixel for monochrome images, converted from Color by luma
+class Gray8 {
+public:
+	Gray8();
+	explicit Gray8(const Color::ColorChannel);
+	explicit Gray8(const Color&);
+	~Gray8() = default;
+	void blend(const Gray8&, const float);
+
+	Color::ColorChannel V;
+};
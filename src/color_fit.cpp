@@ -0,0 +1,80 @@
+#include "color_fit.h"
+#include <algorithm>
+#include <cmath>
+
+
+void ColorFit::clear() {
+	samples.clear();
+}
+
+
+void ColorFit::reserve(const std::size_t n) {
+	samples.reserve(n);
+}
+
+
+// pixel of the source image and the composite without the polygon, with the
+// polygon opaque black and with it opaque white
+void ColorFit::add(const Color& target, const Color& without, const Color& black, const Color& white) {
+	Sample s;
+	float w[3];
+	float b[3];
+	float o[3];
+	channels(target, s.target);
+	channels(without, o);
+	channels(black, b);
+	channels(white, w);
+	for (int ch = 0; ch < 3; ++ch) {
+		s.below[ch] = o[ch] - b[ch];
+		s.above[ch] = b[ch];
+		s.k[ch] = std::max(0.0f, w[ch] - b[ch]) / Color::maxColorChannel;
+	}
+	samples.push_back(s);
+}
+
+
+bool ColorFit::empty() const {
+	return samples.empty();
+}
+
+
+// best color for alpha, returns the modelled absolute error over all samples
+float ColorFit::solve(const float alpha, Color& c) const {
+	float error = 0;
+	Color::ColorChannel best[3];
+	for (int ch = 0; ch < 3; ++ch) {
+		// weighted median of the per-pixel ideal values (clamped, so a histogram
+		// over channel values is exact)
+		float hist[Color::maxColorChannel + 1] = {};
+		float total = 0;
+		for (auto it = samples.cbegin(); it != samples.cend(); ++it) {
+			const float w = alpha * (*it).k[ch];
+			if (w <= 0)
+				continue;
+			const float base = (1.0f - alpha) * (*it).below[ch] + (*it).above[ch];
+			const float t = ((*it).target[ch] - base) / w;
+			const int bin = static_cast<int>(std::lround(std::min(std::max(t, 0.0f), static_cast<float>(Color::maxColorChannel))));
+			hist[bin] += w;
+			total += w;
+		}
+		int v = 0;
+		float sum = hist[0];
+		while (v < Color::maxColorChannel && sum < total / 2)
+			sum += hist[++v];
+		best[ch] = static_cast<Color::ColorChannel>(v);
+
+		for (auto it = samples.cbegin(); it != samples.cend(); ++it) {
+			const float base = (1.0f - alpha) * (*it).below[ch] + (*it).above[ch];
+			error += std::abs((*it).target[ch] - base - alpha * (*it).k[ch] * v);
+		}
+	}
+	c = Color{best[0], best[1], best[2]};
+	return error;
+}
+
+
+void ColorFit::channels(const Color& c, float* out) {
+	out[0] = c.R;
+	out[1] = c.G;
+	out[2] = c.B;
+}
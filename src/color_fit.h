@@ -0,0 +1,33 @@
+#pragma once
+
+#include "color.h"
+#include <cstddef>
+#include <vector>
+
+
+// Closed-form color for a polygon with fixed geometry. Each covered pixel is
+// sampled with the polygon left out, drawn opaque black and drawn opaque white,
+// which gives the composite as a linear function of the polygon's color:
+// final = (1 - alpha) * (without - black) + black + alpha * k * color
+// where k is the transmittance of the polygons above. For a given alpha the
+// absolute error is minimized per channel by a weighted median.
+class ColorFit {
+public:
+	ColorFit() = default;
+	~ColorFit() = default;
+	void clear(void);
+	void reserve(const std::size_t);
+	void add(const Color&, const Color&, const Color&, const Color&);
+	bool empty(void) const;
+	float solve(const float, Color&) const;
+private:
+	struct Sample {
+		float target[3];
+		float below[3];	// without - black
+		float above[3];	// black
+		float k[3];	// (white - black) / 255
+	};
+	static void channels(const Color&, float*);
+
+	std::vector<Sample> samples;
+};
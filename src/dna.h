@@ -2,6 +2,7 @@
 
 #include "color.h"
 #include "polygon.h"
+#include <algorithm>
 #include <vector>
 
 
@@ -21,6 +22,7 @@ public:
 		data.reserve(polyCount);
 	}
 	~DNA() = default;
+	DNA& operator=(const DNA&) = default;
 
 	void add(const Polygon& p, const Color& c, const float a) {
 		PolyDNA pd;
@@ -37,7 +39,23 @@ public:
 		return data.empty();
 	}
 
+	// map vertices from a w0 x h0 image onto a w1 x h1 image (pixel centers),
+	// false (vertices unchanged) if either size has no pixels
+	bool scale(const int w0, const int h0, const int w1, const int h1) {
+		if (w0 <= 0 || h0 <= 0 || w1 <= 0 || h1 <= 0)
+			return false;
+		const float sx = static_cast<float>(w1) / w0;
+		const float sy = static_cast<float>(h1) / h0;
+		for (auto it = data.begin(); it != data.end(); ++it) {
+			for (auto vit = (*it).v.begin(); vit != (*it).v.end(); ++vit) {
+				(*vit).x = std::min(static_cast<int>(((*vit).x + 0.5f) * sx), w1 - 1);
+				(*vit).y = std::min(static_cast<int>(((*vit).y + 0.5f) * sy), h1 - 1);
+			}
+		}
+		return true;
+	}
+
 	std::size_t polyCount = 0;
-	std::size_t vertCount = 0;
+	std::size_t vertCount = 0;	// 0 if polygons have different vertex counts
 	std::vector<PolyDNA> data;
 };
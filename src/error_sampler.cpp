@@ -0,0 +1,99 @@
+#include "error_sampler.h"
+#include "checkpoint.h"
+
+
+ErrorSampler::ErrorSampler(const int w, const int h, const int bs)
+: width(w), height(h), blockSize(bs),
+  countX(w % bs == 0 ? w / bs : w / bs + 1),
+  countY(h % bs == 0 ? h / bs : h / bs + 1),
+  weights(countX * countY, 0), tree(countX * countY + 1, 0) {
+	topBit = 1;
+	while (topBit * 2 <= countX * countY)
+		topBit *= 2;
+}
+
+
+// set weight of block (i, j)
+void ErrorSampler::set(const int i, const int j, const float w) {
+	const int k = i * countY + j;
+	const float weight = std::max(w, 0.0f);
+	const double delta = static_cast<double>(weight) - weights[k];
+	weights[k] = weight;
+	const int n = static_cast<int>(weights.size());
+	for (int pos = k + 1; pos <= n; pos += pos & (-pos))
+		tree[pos] += delta;
+}
+
+
+// u in [0, 1), returns block index, or -1 if every weight is 0
+int ErrorSampler::sample(const float u) const {
+	const int n = static_cast<int>(weights.size());
+	double rem = u * total();
+	if (!(rem > 0))
+		return -1;
+	int pos = 0;
+	for (int step = topBit; step > 0; step /= 2) {
+		if (pos + step <= n && tree[pos + step] <= rem) {
+			pos += step;
+			rem -= tree[pos];
+		}
+	}
+	return std::min(pos, n - 1);
+}
+
+
+double ErrorSampler::total() const {
+	return prefix(weights.size());
+}
+
+
+// pixels covered by block index (inclusive)
+Rectangle ErrorSampler::blockRect(const int k) const {
+	Rectangle r;
+	r.x0 = blockI(k) * blockSize;
+	r.y0 = blockJ(k) * blockSize;
+	r.x1 = std::min(r.x0 + blockSize, width) - 1;
+	r.y1 = std::min(r.y0 + blockSize, height) - 1;
+	return r;
+}
+
+
+int ErrorSampler::blockI(const int k) const {
+	return k / countY;
+}
+
+
+int ErrorSampler::blockJ(const int k) const {
+	return k % countY;
+}
+
+
+// the tree is stored as is, rebuilding it would round its sums differently
+void ErrorSampler::save(CheckpointWriter& w) const {
+	w.put32(weights.size());
+	for (auto it = weights.cbegin(); it != weights.cend(); ++it)
+		w.putFloat(*it);
+	for (auto it = tree.cbegin(); it != tree.cend(); ++it)
+		w.putDouble(*it);
+}
+
+
+// false if the checkpoint has a different block count
+bool ErrorSampler::load(CheckpointReader& r) {
+	if (r.get32() != weights.size())
+		return false;
+	for (auto it = weights.begin(); it != weights.end(); ++it)
+		*it = r.getFloat();
+	for (auto it = tree.begin(); it != tree.end(); ++it)
+		*it = r.getDouble();
+	return r.good();
+}
+
+
+// sum of first n weights
+double ErrorSampler::prefix(int n) const {
+	double sum = 0;
+	for (; n > 0; n -= n & (-n))
+		sum += tree[n];
+	return sum;
+}
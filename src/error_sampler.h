@@ -0,0 +1,37 @@
+#pragma once
+
+#include "shape.h"
+#include <algorithm>
+#include <vector>
+
+
+class CheckpointReader;
+class CheckpointWriter;
+
+
+// Samples img_iter blocks with probability proportional to their error.
+// Weights are kept in a Fenwick tree, so updates and samples are O(log n).
+class ErrorSampler {
+public:
+	ErrorSampler(const int, const int, const int);
+	~ErrorSampler() = default;
+	void set(const int, const int, const float);
+	int sample(const float) const;
+	double total(void) const;
+	Rectangle blockRect(const int) const;
+	int blockI(const int) const;
+	int blockJ(const int) const;
+	void save(CheckpointWriter&) const;
+	bool load(CheckpointReader&);
+private:
+	double prefix(int) const;
+
+	const int width;
+	const int height;
+	const int blockSize;
+	const int countX;
+	const int countY;
+	std::vector<float> weights;
+	std::vector<double> tree;	// 1-based
+	int topBit;	// highest power of 2 <= size
+};
@@ -1,10 +1,18 @@
 #include "file_helper.h"
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 
 std::string ImageFormatToExtension(const ImageFormat f) {
 	switch (f) {
 	case ImageFormat::PPM:
 		return "ppm";
+	case ImageFormat::QOI:
+		return "qoi";
 	case ImageFormat::NONE:
 	default:
 		return std::string();
@@ -15,13 +23,40 @@ std::string ImageFormatToExtension(const ImageFormat f) {
 ImageFormat extensionToImageFormat(const std::string& extension) {
 	std::string ext{extension};
 	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-	if (ext == "ppm")
+	if (ext == "ppm" || ext == "pgm")
 		return ImageFormat::PPM;
+	else if (ext == "qoi")
+		return ImageFormat::QOI;
 	else
 		return ImageFormat::NONE;
 }
 
 
+std::string DNAFormatToExtension(const DNAFormat f) {
+	switch (f) {
+	case DNAFormat::TEXT:
+		return "txt";
+	case DNAFormat::BINARY:
+		return "dna";
+	case DNAFormat::NONE:
+	default:
+		return std::string();
+	}
+}
+
+
+DNAFormat extensionToDNAFormat(const std::string& extension) {
+	std::string ext{extension};
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	if (ext == "txt")
+		return DNAFormat::TEXT;
+	else if (ext == "dna")
+		return DNAFormat::BINARY;
+	else
+		return DNAFormat::NONE;
+}
+
+
 bool ImageReader::read(const std::string& fpath) {
 	using namespace FileHelper;
 	path = fpath;
@@ -36,6 +71,9 @@ bool ImageReader::read(const std::string& fpath) {
 	case ImageFormat::PPM:
 		reader = new readPPM;
 		break;
+	case ImageFormat::QOI:
+		reader = new readQOI;
+		break;
 	}
 
 	bool ret = false;
@@ -43,7 +81,7 @@ bool ImageReader::read(const std::string& fpath) {
 		ret = reader->read(path);
 		error = reader->error;
 		if (ret)
-			img = reader->img;
+			img.swap(reader->img);
 		delete reader;
 	}
 	return ret;
@@ -82,24 +120,65 @@ ImageFormat ImageReader::getFormat(const std::string& path) {
 }
 
 
+ImageWriter::~ImageWriter() {
+	delete stream;
+}
+
+
 bool ImageWriter::write(const Image& img, const std::string& path, ImageFormat format) {
+	if (!begin(path, format, img.width(), img.height()))
+		return false;
+	for (int y = 0; y < img.height(); ++y) {
+		if (!writeRow(img.row(y)))
+			return false;
+	}
+	return end();
+}
+
+
+// starts a w x h image at path, its rows follow
+bool ImageWriter::begin(const std::string& path, const ImageFormat format, const int w, const int h) {
 	using namespace FileHelper;
-	ImgWriterBase* writer = nullptr;
+	delete stream;
+	stream = nullptr;
 	switch (format) {
 	case ImageFormat::NONE:
 		break;
 	case ImageFormat::PPM:
-		writer = new writePPM();
+		stream = new writePPM(staging);
+		break;
+	case ImageFormat::QOI:
+		stream = new writeQOI(staging);
 		break;
 	}
 
-	if (writer == nullptr)
+	if (stream != nullptr && !stream->begin(path, w, h)) {
+		delete stream;
+		stream = nullptr;
+	}
+	return stream != nullptr;
+}
+
+
+bool ImageWriter::writeRow(const Color* row) {
+	if (stream == nullptr)
+		return false;
+	if (!stream->writeRow(row)) {
+		delete stream;
+		stream = nullptr;
 		return false;
-	else {
-		bool ret = writer->write(img, path);
-		delete writer;
-		return ret;
 	}
+	return true;
+}
+
+
+bool ImageWriter::end() {
+	if (stream == nullptr)
+		return false;
+	const bool ret = stream->end();
+	delete stream;
+	stream = nullptr;
+	return ret;
 }
 
 
@@ -246,247 +325,718 @@ FileWriter& FileWriter::operator<<(const T& a) {
 }
 
 
-bool readPPM::read(const std::string& path) {
-	std::ifstream f{path, std::ifstream::in | std::ifstream::binary};
+MappedFile::~MappedFile() {
+	close();
+}
+
+
+// sequential hints the OS to read ahead, otherwise access is random
+bool MappedFile::open(const std::string& path, const bool sequential) {
+	close();
+#ifdef __linux__
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	length = static_cast<std::size_t>(st.st_size);
+	if (length > 0) {
+		void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED) {
+			madvise(p, length, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+			ptr = static_cast<const unsigned char*>(p);
+			mapped = true;
+		}
+	}
+	::close(fd);
+	if (mapped || length == 0)
+		return true;
+#endif
+	// one bulk read
+	std::ifstream f{path, std::ifstream::in | std::ifstream::binary | std::ifstream::ate};
+	if (!f)
+		return false;
+	length = static_cast<std::size_t>(f.tellg());
+	buffer.resize(length);
+	f.seekg(0);
+	f.read(reinterpret_cast<char*>(buffer.data()), length);
 	if (!f) {
+		close();
+		return false;
+	}
+	ptr = buffer.data();
+	return true;
+}
+
+
+void MappedFile::close() {
+#ifdef __linux__
+	if (mapped)
+		munmap(const_cast<unsigned char*>(ptr), length);
+#endif
+	ptr = nullptr;
+	length = 0;
+	mapped = false;
+	buffer.clear();
+	buffer.shrink_to_fit();
+}
+
+
+// n bytes from offset are not needed for now: their pages are dropped (read
+// back from the file on the next access), only whole pages are released
+void MappedFile::release(const std::size_t offset, const std::size_t n) const {
+#ifdef __linux__
+	if (!mapped || n == 0)
+		return;
+	const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	const std::size_t begin = (offset + page - 1) / page * page;
+	const std::size_t end = (offset + n) / page * page;
+	if (begin < end)
+		madvise(const_cast<unsigned char*>(ptr) + begin, end - begin, MADV_DONTNEED);
+#else
+	(void)offset;
+	(void)n;
+#endif
+}
+
+
+const unsigned char* MappedFile::data() const {
+	return ptr;
+}
+
+
+std::size_t MappedFile::size() const {
+	return length;
+}
+
+
+bool PPMRows::open(const std::string& path) {
+	if (!file.open(path)) {
 		error = "cannot open file";
 		return false;
 	}
-	auto readChar = [&f] () {return static_cast<char>(f.get());};
-	auto digitToInt = [] (char c) {return c - '0';};
-	char c = 0;	// character read
-	int width;
-	int height;
-	int maxColor;
+	const unsigned char* p = file.data();
+	const unsigned char* end = p + file.size();
+
 	// read header data
-	// determine type
-	std::string type;
-	while (type.size() < 2) {
-		c = readChar();
-		type += c;
-	}
-	if (type != std::string("P6")) {
+	// determine type: P6 is RGB, P5 (pgm) gray
+	if (end - p < 2 || p[0] != 'P' || (p[1] != '6' && p[1] != '5')) {
 		error = "unknown format";
 		return false;
 	}
-
-	// get width;
-	// continue to first non-whitespace character
-	while (f && isspace(c = readChar()))
-		;
-	if (!isdigit(c)) {
+	channels = p[1] == '6' ? 3 : 1;
+	p += 2;
+	std::size_t width;
+	std::size_t height;
+	std::size_t maxval;
+	p = readNumber(skipSpace(p, end), end, width);
+	if (p != nullptr)
+		p = readNumber(skipSpace(p, end), end, height);
+	if (p != nullptr)
+		p = readNumber(skipSpace(p, end), end, maxval);
+	// exactly one whitespace character before pixel data
+	if (p == nullptr || p == end || !std::isspace(*p)) {
 		error = "invalid data";
 		return false;
 	}
-	width = digitToInt(c);
-	while (isdigit(c = readChar()))
-		width = width * 10 + digitToInt(c);
-	// continue to non-whitespace
-	while (isspace(c = readChar()))
-		;
-	if (!isdigit(c)) {
-		error = "invalid data";
+	++p;
+	if (width == 0 || height == 0 || width > 1 << 20 || height > 1 << 20) {
+		error = "invalid image size";
+		return false;
+	}
+	if (maxval == 0 || maxval > 65535) {
+		error = "invalid max color value";
+		return false;
+	}
+	rowBytes = width * channels * (maxval > 255 ? 2 : 1);
+	if (static_cast<std::size_t>(end - p) / rowBytes < height) {
+		error = "file is truncated";
+		return false;
+	}
+	pixels = p;
+	w = width;
+	h = height;
+	maxColor = maxval;
+	return true;
+}
+
+
+int PPMRows::width() const {
+	return w;
+}
+
+
+int PPMRows::height() const {
+	return h;
+}
+
+
+// Converts row y to dst (width() pixels). 8 bit RGB rows are copied, others
+// are expanded and scaled to 0..255.
+void PPMRows::read(const int y, Color* dst) const {
+	const unsigned char* src = pixels + y * rowBytes;
+	if (channels == 3 && maxColor == 255) {
+		std::memcpy(&dst[0].R, src, w * sizeof(Color));
+		return;
+	}
+	if (maxColor == 255) {
+		for (int x = 0; x < w; ++x)
+			dst[x] = Color(src[x], src[x], src[x]);
+		return;
+	}
+	const int bytes = maxColor > 255 ? 2 : 1;
+	const int samples = w * channels;
+	const int maxval = maxColor;
+	auto scale = [&src, bytes, maxval] (const int i) {
+		const unsigned int v = bytes == 2 ? (src[2 * i] << 8 | src[2 * i + 1]) : src[i];
+		return static_cast<Color::ColorChannel>((std::min<unsigned int>(v, maxval) * 255 + maxval / 2) / maxval);
+	};
+	Color::ColorChannel* out = &dst[0].R;
+	if (channels == 3) {
+		for (int i = 0; i < samples; ++i)
+			out[i] = scale(i);
+	}
+	else {
+		for (int x = 0; x < w; ++x) {
+			const Color::ColorChannel v = scale(x);
+			dst[x] = Color(v, v, v);
+		}
+	}
+}
+
+
+// rows before y will not be read again, their pages can be dropped
+void PPMRows::release(const int y) const {
+	file.release(0, pixels + y * rowBytes - file.data());
+}
+
+
+const std::string& PPMRows::getError() const {
+	return error;
+}
+
+
+// skips whitespace and comments (# to end of line)
+const unsigned char* PPMRows::skipSpace(const unsigned char* p, const unsigned char* end) {
+	while (p != end) {
+		if (*p == '#') {
+			while (p != end && *p != '\n' && *p != '\r')
+				++p;
+		}
+		else if (std::isspace(*p))
+			++p;
+		else
+			break;
+	}
+	return p;
+}
+
+
+// returns the end of the number or nullptr if there is none
+const unsigned char* PPMRows::readNumber(const unsigned char* p, const unsigned char* end, std::size_t& n) {
+	if (p == end || !std::isdigit(*p))
+		return nullptr;
+	n = 0;
+	while (p != end && std::isdigit(*p)) {
+		n = n * 10 + (*p - '0');
+		if (n > 1 << 24)
+			return nullptr;
+		++p;
+	}
+	return p;
+}
+
+
+bool readPPM::read(const std::string& path) {
+	PPMRows rows;
+	if (!rows.open(path)) {
+		error = rows.getError();
 		return false;
 	}
-	height = digitToInt(c);
-	while (isdigit(c = readChar()))
-		height = height * 10 + digitToInt(c);
+	img.resize(rows.width(), rows.height());
+	for (int y = 0; y < rows.height(); ++y)
+		rows.read(y, img.row(y));
+	return true;
+}
+
 
-	// assuming 3 bytes per pixel
-	if ((static_cast<float>(width * height * 3) / 1000 / 1000) > limitMB) {
-		error = "image too large";
+bool writePPM::begin(const std::string& path, const int w, const int h) {
+	if (!f.open(path))
 		return false;
+	const std::string header = std::string("P6\n") + patch::to_string(w) + ' '
+		+ patch::to_string(h) + std::string("\n255\n");
+	rowBytes = w * sizeof(Color);
+	staging.resize(std::max(blockSize, header.size() + rowBytes));
+	std::memcpy(staging.data(), header.c_str(), header.size());
+	used = header.size();
+	return true;
+}
+
+
+bool writePPM::writeRow(const Color* row) {
+	if (used + rowBytes > staging.size()) {
+		if (!f.write(staging.data(), used))
+			return false;
+		used = 0;
 	}
+	std::memcpy(staging.data() + used, &row[0].R, rowBytes);
+	used += rowBytes;
+	return true;
+}
 
-	// get max color value
-	// continue to non-whitespace
-	while (isspace(c = readChar()))
-		;
-	if (!isdigit(c)) {
-		error = "invalid data";
+
+bool writePPM::end() {
+	if (!f.write(staging.data(), used))
+		return false;
+	return f.commit();
+}
+
+
+std::uint32_t readQOI::readBE32(const unsigned char* p) {
+	return static_cast<std::uint32_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+
+bool readQOI::read(const std::string& path) {
+	MappedFile file;
+	if (!file.open(path)) {
+		error = "cannot open file";
 		return false;
 	}
-	maxColor = digitToInt(c);
-	while (isdigit(c = readChar()))
-		maxColor = maxColor * 10 + digitToInt(c);
-	if (maxColor != 255) {
-		error = "max color value is not 255";
+	const unsigned char* p = file.data();
+	const unsigned char* end = p + file.size();
+	if (file.size() < QOI::headerSize + sizeof(QOI::end) || std::memcmp(p, "qoif", 4) != 0) {
+		error = "unknown format";
 		return false;
 	}
+	const std::uint32_t width = readBE32(p + 4);
+	const std::uint32_t height = readBE32(p + 8);
+	const int channels = p[12];
+	if (width == 0 || height == 0 || width > 1 << 20 || height > 1 << 20 || (channels != 3 && channels != 4)) {
+		error = "invalid data";
+		return false;
+	}
+	p += QOI::headerSize;
+	end -= sizeof(QOI::end);
 
 	img.resize(width, height);
+	QOI::Pixel cache[64] = {};
+	QOI::Pixel px{0, 0, 0, 255};
+	int run = 0;
+	for (std::uint32_t y = 0; y < height; ++y) {
+		Color* row = img.row(y);
+		for (std::uint32_t x = 0; x < width; ++x) {
+			if (run > 0)
+				--run;
+			else {
+				if (p >= end) {
+					error = "file is truncated";
+					return false;
+				}
+				const unsigned char b = *p++;
+				if (b == QOI::rgb || b == QOI::rgba) {
+					const int n = b == QOI::rgb ? 3 : 4;
+					if (end - p < n) {
+						error = "file is truncated";
+						return false;
+					}
+					px.r = p[0];
+					px.g = p[1];
+					px.b = p[2];
+					if (n == 4)
+						px.a = p[3];
+					p += n;
+				}
+				else if ((b & QOI::mask) == QOI::index)
+					px = cache[b];
+				else if ((b & QOI::mask) == QOI::diff) {
+					px.r += ((b >> 4) & 3) - 2;
+					px.g += ((b >> 2) & 3) - 2;
+					px.b += (b & 3) - 2;
+				}
+				else if ((b & QOI::mask) == QOI::luma) {
+					if (p == end) {
+						error = "file is truncated";
+						return false;
+					}
+					const int dg = (b & 0x3f) - 32;
+					const unsigned char b2 = *p++;
+					px.r += dg - 8 + ((b2 >> 4) & 0x0f);
+					px.g += dg;
+					px.b += dg - 8 + (b2 & 0x0f);
+				}
+				else
+					run = b & 0x3f;
+				cache[px.hash()] = px;
+			}
+			row[x] = Color(px.r, px.g, px.b);
+		}
+	}
+	return true;
+}
+
 
-	// read pixel data
-	Color color;
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			color.R = static_cast<Color::ColorChannel>(readChar());
-			color.G = static_cast<Color::ColorChannel>(readChar());
-			color.B = static_cast<Color::ColorChannel>(readChar());
-			img.set(x, y, color);
+void writeQOI::writeBE32(unsigned char* p, const std::uint32_t v) {
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+
+bool writeQOI::begin(const std::string& path, const int w, const int h) {
+	if (!f.open(path))
+		return false;
+	width = w;
+	// worst case per row: every pixel as RGB chunk plus a run carried over
+	rowBytes = w * 4 + 1;
+	staging.resize(std::max(blockSize, QOI::headerSize + rowBytes + sizeof(QOI::end)));
+	unsigned char* out = staging.data();
+	std::memcpy(out, "qoif", 4);
+	writeBE32(out + 4, w);
+	writeBE32(out + 8, h);
+	out[12] = 3;	// channels
+	out[13] = 0;	// sRGB
+	used = QOI::headerSize;
+	return true;
+}
+
+
+bool writeQOI::writeRow(const Color* row) {
+	if (used + rowBytes > staging.size()) {
+		if (!f.write(staging.data(), used))
+			return false;
+		used = 0;
+	}
+	unsigned char* out = staging.data() + used;
+	for (int x = 0; x < width; ++x) {
+		const QOI::Pixel px{row[x].R, row[x].G, row[x].B, 255};
+		if (px == prev) {
+			if (++run == 62) {
+				*out++ = QOI::run | (run - 1);
+				run = 0;
+			}
+			continue;
+		}
+		if (run > 0) {
+			*out++ = QOI::run | (run - 1);
+			run = 0;
+		}
+		const int h = px.hash();
+		if (cache[h] == px)
+			*out++ = QOI::index | h;
+		else {
+			cache[h] = px;
+			const signed char dr = px.r - prev.r;
+			const signed char dg = px.g - prev.g;
+			const signed char db = px.b - prev.b;
+			const int drg = dr - dg;
+			const int dbg = db - dg;
+			if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
+				*out++ = QOI::diff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+			else if (dg > -33 && dg < 32 && drg > -9 && drg < 8 && dbg > -9 && dbg < 8) {
+				*out++ = QOI::luma | (dg + 32);
+				*out++ = (drg + 8) << 4 | (dbg + 8);
+			}
+			else {
+				*out++ = QOI::rgb;
+				*out++ = px.r;
+				*out++ = px.g;
+				*out++ = px.b;
+			}
 		}
+		prev = px;
 	}
+	used = out - staging.data();
+	return true;
+}
 
-	f.close();
+
+bool writeQOI::end() {
+	if (used + 1 + sizeof(QOI::end) > staging.size()) {
+		if (!f.write(staging.data(), used))
+			return false;
+		used = 0;
+	}
+	if (run > 0)
+		staging[used++] = QOI::run | (run - 1);
+	std::memcpy(staging.data() + used, QOI::end, sizeof(QOI::end));
+	used += sizeof(QOI::end);
+	if (!f.write(staging.data(), used))
+		return false;
+	return f.commit();
+}
+
+
+AtomicFile::~AtomicFile() {
+	discard();
+}
+
+
+bool AtomicFile::open(const std::string& fpath) {
+	discard();
+	path = fpath;
+	tmpPath = path + ".tmp";
+	f = std::fopen(tmpPath.c_str(), "wb");
+	if (f == nullptr)
+		return false;
+	// writes are already large, skip stdio buffering
+	std::setvbuf(f, nullptr, _IONBF, 0);
 	return true;
 }
 
 
-bool writePPM::write(const Image& img, const std::string& path) {
-	std::ofstream f{path, std::ofstream::out | std::ofstream::binary};
-	if (!f)
+bool AtomicFile::write(const void* data, const std::size_t size) {
+	if (f == nullptr)
 		return false;
-	// write header
-	std::string header = std::string("P6\n") + patch::to_string(img.width()) + ' '
-		+ patch::to_string(img.height()) + std::string("\n255\n");
-	f.write(header.c_str(), header.size());
-	if (f.fail())
+	if (std::fwrite(data, 1, size, f) != size) {
+		discard();
 		return false;
-	// write data
-	unsigned char pxData[3];	// pixel data
-	for (int y = 0; y < img.height(); ++y) {
-		for (int x = 0; x < img.width(); ++x) {
-			const Color c{img.get(x, y)};
-			pxData[0] = static_cast<unsigned char>(c.R);
-			pxData[1] = static_cast<unsigned char>(c.G);
-			pxData[2] = static_cast<unsigned char>(c.B);
-			f.write(reinterpret_cast<char*>(pxData), 3);
-			if (f.fail())
-				return false;
+	}
+	return true;
+}
+
+
+bool AtomicFile::commit() {
+	if (f == nullptr)
+		return false;
+	const bool closed = std::fclose(f) == 0;
+	f = nullptr;
+	if (!closed) {
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+	// rename does not replace an existing file on every platform
+	if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+		std::remove(path.c_str());
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+			std::remove(tmpPath.c_str());
+			return false;
 		}
 	}
-	f.close();
 	return true;
 }
 
 
+// closes and removes the temporary file if not committed
+void AtomicFile::discard() {
+	if (f == nullptr)
+		return;
+	std::fclose(f);
+	f = nullptr;
+	std::remove(tmpPath.c_str());
+}
+
+
+// binary if the file starts with the binary magic, text otherwise
 DNA readDNA(const std::string& path, std::string& error) {
+	MappedFile file;
+	if (!file.open(path)) {
+		error = "unable to open file";
+		return DNA();
+	}
+	if (file.size() >= sizeof(DNABinary::magic) && std::memcmp(file.data(), DNABinary::magic, sizeof(DNABinary::magic)) == 0)
+		return readDNABinary(file.data(), file.size(), error);
+	return readDNAText(file.data(), file.size(), error);
+}
+
+
+bool writeDNA(const DNA& d, const std::string& path, const DNAFormat format) {
+	switch (format) {
+	case DNAFormat::TEXT:
+		return writeDNAText(d, path);
+	case DNAFormat::BINARY:
+		return writeDNABinary(d, path);
+	case DNAFormat::NONE:
+	default:
+		return false;
+	}
+}
+
+
+// 32 bit FNV-1a
+std::uint32_t FileHelper::checksum(const unsigned char* p, const std::size_t n) {
+	std::uint32_t h = 2166136261u;
+	for (std::size_t i = 0; i < n; ++i) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+
+// one pass over the buffer, polygons are filled in place
+DNA FileHelper::readDNAText(const unsigned char* data, const std::size_t size, std::string& error) {
 	DNA dnaError;	// return this if there was an error or invalid format
 	DNA d;
-	FileReader r;
-	if (!r.open(path)) {
-		error = "unable to open file";
+	TextScanner sc{data, size};
+	auto fail = [&sc, &error, &dnaError] (const char* msg) {
+		error = sc.position() + ": " + msg;
 		return dnaError;
-	}
-	if (r.eof()) {
+	};
+	if (sc.atEnd()) {
 		error = "empty file";
 		return dnaError;
 	}
 
-	int value;
-	std::string word;
+	std::size_t value;
 	// vertex count
-	word = r.readWord();
-	if (!isUInt(word)) {
-		error = "invalid vertex count";
-		return dnaError;
-	}
-	value = std::atoi(word.c_str());
-	if (value < 3) {
-		error = "invalid vertex count";
-		return dnaError;
-	}
+	if (!sc.readUInt(value) || (value < 3 && value != 0))
+		return fail("invalid vertex count");
 	d.vertCount = value;
 	// polygon count
-	word = r.readWord();
-	if (!isUInt(word)) {
-		error = "invalid polygon count";
-		return dnaError;
-	}
-	value = std::atoi(word.c_str());
-	if (value < 1) {
-		error = "invalid polygon count";
-		return dnaError;
-	}
+	if (!sc.readUInt(value) || value < 1)
+		return fail("invalid polygon count");
 	d.polyCount = value;
+	// a polygon is at least 10 numbers with separators, this only bounds the allocation
+	if (d.polyCount > size / 14)
+		return fail("polygon count larger than the file");
+	d.data.resize(d.polyCount);
 	// read polygons
-	Color color;
-	float alpha;
-	Point pp;
-	Polygon p;
-	for (std::size_t i = 0; i < d.polyCount; ++i) {
-		// R
-		word = r.readWord();
-		if (!isUInt(word)) {
-			error = "invalid color R value";
-			return dnaError;
+	for (auto it = d.data.begin(); it != d.data.end(); ++it) {
+		// vertex count of this polygon
+		std::size_t vertCount = d.vertCount;
+		if (d.vertCount == 0) {
+			if (!sc.readUInt(vertCount) || vertCount < 3)
+				return fail("invalid polygon vertex count");
+			if (vertCount > size / 4)
+				return fail("polygon vertex count larger than the file");
 		}
-		value = std::atoi(word.c_str());
-		if (value < Color::minColorChannel || value > Color::maxColorChannel) {
-			error = "invalid color R value";
-			return dnaError;
-		}
-		color.R = static_cast<Color::ColorChannel>(value);
-		// G
-		word = r.readWord();
-		if (!isUInt(word)) {
-			error = "invalid color G value";
-			return dnaError;
-		}
-		value = std::atoi(word.c_str());
-		if (value < Color::minColorChannel || value > Color::maxColorChannel) {
-			error = "invalid color G value";
-			return dnaError;
-		}
-		color.G = static_cast<Color::ColorChannel>(value);
-		// B
-		word = r.readWord();
-		if (!isUInt(word)) {
-			error = "invalid color B value";
-			return dnaError;
-		}
-		value = std::atoi(word.c_str());
-		if (value < Color::minColorChannel || value > Color::maxColorChannel) {
-			error = "invalid color B value";
-			return dnaError;
-		}
-		color.B = static_cast<Color::ColorChannel>(value);
+		// R G B
+		if (!sc.readUInt(value) || value > Color::maxColorChannel)
+			return fail("invalid color R value");
+		(*it).color.R = static_cast<Color::ColorChannel>(value);
+		if (!sc.readUInt(value) || value > Color::maxColorChannel)
+			return fail("invalid color G value");
+		(*it).color.G = static_cast<Color::ColorChannel>(value);
+		if (!sc.readUInt(value) || value > Color::maxColorChannel)
+			return fail("invalid color B value");
+		(*it).color.B = static_cast<Color::ColorChannel>(value);
 		// A
-		word = r.readWord();
-		if (!isSimpleFloat(word)) {
-			error = "invalid alpha value";
-			return dnaError;
-		}
-		alpha = static_cast<float>(std::atof(word.c_str()));
-		if (alpha < 0 || alpha > 1) {
-			error = "invalid alpha value";
-			return dnaError;
-		}
+		if (!sc.readFloat((*it).alpha) || (*it).alpha < 0 || (*it).alpha > 1)
+			return fail("invalid alpha value");
 		// vertices
-		for (std::size_t j = 0; j < d.vertCount; ++j) {
-			// X
-			word = r.readWord();
-			if (!isUInt(word)) {
-				error = "invalid vertex x value";
-				return dnaError;
-			}
-			value = std::atoi(word.c_str());
-			pp.x = value;
-			// Y
-			word = r.readWord();
-			if (!isUInt(word)) {
-				error = "invalid vertex y value";
-				return dnaError;
-			}
-			value = std::atoi(word.c_str());
-			pp.y = value;
-			p.add(pp);
+		(*it).v.resize(vertCount);
+		for (auto vit = (*it).v.begin(); vit != (*it).v.end(); ++vit) {
+			if (!sc.readUInt(value) || value > INT32_MAX)
+				return fail("invalid vertex x value");
+			(*vit).x = static_cast<int>(value);
+			if (!sc.readUInt(value) || value > INT32_MAX)
+				return fail("invalid vertex y value");
+			(*vit).y = static_cast<int>(value);
 		}
-		d.add(p, color, alpha);
-		p.clear();
 	}
 	return d;
 }
 
 
+TextScanner::TextScanner(const unsigned char* data, const std::size_t size)
+: p(data), last(data + size), lineStart(data), token(data) {
+}
+
+
+bool TextScanner::atEnd() {
+	skipSpace();
+	token = p;
+	return p == last;
+}
+
+
+// digits followed by whitespace or the end
+bool TextScanner::readUInt(std::size_t& n) {
+	skipSpace();
+	token = p;
+	if (p == last || !std::isdigit(*p))
+		return false;
+	n = 0;
+	for (; p != last && std::isdigit(*p); ++p) {
+		if (n > (SIZE_MAX - 9) / 10)
+			return false;
+		n = n * 10 + (*p - '0');
+	}
+	return p == last || std::isspace(*p);
+}
+
+
+// [+-]digits[.digits][e[+-]digits] with at least one digit, followed by whitespace or the end
+bool TextScanner::readFloat(float& f) {
+	skipSpace();
+	token = p;
+	bool negative = false;
+	if (p != last && (*p == '+' || *p == '-'))
+		negative = *p++ == '-';
+	std::uint64_t mantissa = 0;
+	int scale = 0;	// power of ten
+	int digits = 0;
+	bool period = false;
+	for (; p != last; ++p) {
+		if (std::isdigit(*p)) {
+			// digits past 18 only matter for rounding beyond float precision
+			if (mantissa < 100000000000000000ull) {
+				mantissa = mantissa * 10 + (*p - '0');
+				scale -= period ? 1 : 0;
+			}
+			else
+				scale += period ? 0 : 1;
+			++digits;
+		}
+		else if (*p == '.' && !period)
+			period = true;
+		else
+			break;
+	}
+	if (digits == 0)
+		return false;
+	if (p != last && (*p == 'e' || *p == 'E')) {
+		++p;
+		bool negExp = false;
+		if (p != last && (*p == '+' || *p == '-'))
+			negExp = *p++ == '-';
+		if (p == last || !std::isdigit(*p))
+			return false;
+		int e = 0;
+		for (; p != last && std::isdigit(*p); ++p)
+			e = std::min(e * 10 + (*p - '0'), 1000);
+		scale += negExp ? -e : e;
+	}
+	if (p != last && !std::isspace(*p))
+		return false;
+	double v = static_cast<double>(mantissa);
+	v = scale < 0 ? v / std::pow(10.0, -scale) : v * std::pow(10.0, scale);
+	f = static_cast<float>(negative ? -v : v);
+	return true;
+}
+
+
+// "line L, column C" of the start of the last token read
+std::string TextScanner::position() const {
+	return "line " + patch::to_string(line) + ", column " + patch::to_string(token - lineStart + 1);
+}
+
+
+void TextScanner::skipSpace() {
+	for (; p != last && std::isspace(*p); ++p) {
+		if (*p == '\n') {
+			++line;
+			lineStart = p + 1;
+		}
+	}
+}
+
+
 // returns true if successfully wrote DNA data to file
-bool writeDNA(const DNA& d, const std::string& path) {
+bool FileHelper::writeDNAText(const DNA& d, const std::string& path) {
 	std::ofstream f{path};
 	if (!f)
 		return false;
 
 	f << d.vertCount << ' ' << d.polyCount;
 	for (auto it = d.data.cbegin(); it != d.data.cend(); ++it) {
+		if (d.vertCount == 0)
+			f << ' ' << (*it).v.size();
 		f << ' ' << static_cast<int>((*it).color.R);
 		f << ' ' << static_cast<int>((*it).color.G);
 		f << ' ' << static_cast<int>((*it).color.B);
@@ -500,3 +1050,134 @@ bool writeDNA(const DNA& d, const std::string& path) {
 	f.close();
 	return true;
 }
+
+
+// copies the fixed width records straight into the DNA's polygon storage
+DNA FileHelper::readDNABinary(const unsigned char* data, const std::size_t size, std::string& error) {
+	DNA dnaError;
+	auto get16 = [] (const unsigned char* p) {return static_cast<std::uint16_t>(p[0] | p[1] << 8);};
+	auto get32 = [] (const unsigned char* p) {
+		return static_cast<std::uint32_t>(p[0]) | p[1] << 8 | p[2] << 16 | static_cast<std::uint32_t>(p[3]) << 24;
+	};
+	if (size < DNABinary::headerSize + 4) {
+		error = "file is truncated";
+		return dnaError;
+	}
+	const std::size_t payload = size - 4;
+	if (checksum(data, payload) != get32(data + payload)) {
+		error = "checksum mismatch";
+		return dnaError;
+	}
+	if (get16(data + 4) != DNABinary::version) {
+		error = "unsupported version";
+		return dnaError;
+	}
+	const bool counts = (get16(data + 6) & DNABinary::vertexCounts) != 0;
+	DNA d;
+	d.vertCount = get32(data + 8);
+	d.polyCount = get32(data + 12);
+	if ((counts ? d.vertCount != 0 : d.vertCount < 3) || d.polyCount < 1) {
+		error = "invalid header";
+		return dnaError;
+	}
+	// smallest possible record size bounds the polygon count before allocating
+	if ((payload - DNABinary::headerSize) / (8 + 3 * 8) < d.polyCount) {
+		error = "file is truncated";
+		return dnaError;
+	}
+
+	d.data.resize(d.polyCount);
+	const unsigned char* p = data + DNABinary::headerSize;
+	const unsigned char* end = data + payload;
+	for (auto it = d.data.begin(); it != d.data.end(); ++it) {
+		std::size_t n = d.vertCount;
+		if (counts) {
+			if (end - p < 2) {
+				error = "file is truncated";
+				return dnaError;
+			}
+			n = get16(p);
+			p += 2;
+			if (n < 3) {
+				error = "invalid polygon vertex count";
+				return dnaError;
+			}
+		}
+		if (static_cast<std::size_t>(end - p) < 8 + n * 8) {
+			error = "file is truncated";
+			return dnaError;
+		}
+		(*it).color = Color(p[0], p[1], p[2]);
+		const std::uint32_t a = get32(p + 4);
+		std::memcpy(&(*it).alpha, &a, sizeof(float));
+		if (!((*it).alpha >= 0 && (*it).alpha <= 1)) {
+			error = "invalid alpha value";
+			return dnaError;
+		}
+		p += 8;
+		(*it).v.resize(n);
+		for (auto vit = (*it).v.begin(); vit != (*it).v.end(); ++vit, p += 8) {
+			(*vit).x = static_cast<std::int32_t>(get32(p));
+			(*vit).y = static_cast<std::int32_t>(get32(p + 4));
+		}
+	}
+	if (p != end) {
+		error = "unexpected data after polygons";
+		return dnaError;
+	}
+	return d;
+}
+
+
+bool FileHelper::writeDNABinary(const DNA& d, const std::string& path) {
+	std::vector<unsigned char> buf;
+	encodeDNABinary(d, buf);
+	AtomicFile f;
+	return f.open(path) && f.write(buf.data(), buf.size()) && f.commit();
+}
+
+
+// replaces buf with the binary file contents of d
+void FileHelper::encodeDNABinary(const DNA& d, std::vector<unsigned char>& buf) {
+	const bool counts = d.vertCount == 0;
+	std::size_t size = DNABinary::headerSize + 4;
+	for (auto it = d.data.cbegin(); it != d.data.cend(); ++it)
+		size += (counts ? 2 : 0) + 8 + (*it).v.size() * 8;
+	buf.resize(size);
+	unsigned char* p = buf.data();
+	auto put16 = [&p] (const std::uint16_t v) {
+		p[0] = v;
+		p[1] = v >> 8;
+		p += 2;
+	};
+	auto put32 = [&p] (const std::uint32_t v) {
+		p[0] = v;
+		p[1] = v >> 8;
+		p[2] = v >> 16;
+		p[3] = v >> 24;
+		p += 4;
+	};
+
+	std::memcpy(p, DNABinary::magic, sizeof(DNABinary::magic));
+	p += sizeof(DNABinary::magic);
+	put16(DNABinary::version);
+	put16(counts ? DNABinary::vertexCounts : 0);
+	put32(d.vertCount);
+	put32(d.data.size());
+	for (auto it = d.data.cbegin(); it != d.data.cend(); ++it) {
+		if (counts)
+			put16((*it).v.size());
+		*p++ = (*it).color.R;
+		*p++ = (*it).color.G;
+		*p++ = (*it).color.B;
+		*p++ = 0;
+		std::uint32_t a;
+		std::memcpy(&a, &(*it).alpha, sizeof(float));
+		put32(a);
+		for (auto vit = (*it).v.cbegin(); vit != (*it).v.cend(); ++vit) {
+			put32(static_cast<std::uint32_t>((*vit).x));
+			put32(static_cast<std::uint32_t>((*vit).y));
+		}
+	}
+	put32(checksum(buf.data(), size - 4));
+}
@@ -5,12 +5,16 @@
 #include "image.h"
 #include <algorithm>
 #include <cctype>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <sstream>
 #include <string>
+#include <vector>
 
 
 // work around error: 'to_string' is not a member of 'std'
@@ -24,7 +28,12 @@ namespace patch {
 }
 
 
-enum class ImageFormat {NONE, PPM};
+namespace FileHelper {
+	class ImgWriterBase;
+}
+
+
+enum class ImageFormat {NONE, PPM, QOI};
 std::string ImageFormatToExtension(const ImageFormat);
 ImageFormat extensionToImageFormat(const std::string&);
 
@@ -50,17 +59,35 @@ private:
 };
 
 
+// write() saves a whole image. An image too large to hold is streamed
+// instead: begin() it, writeRow() each of its rows top to bottom, then end()
+// commits it (a failed call discards it).
 class ImageWriter {
 public:
 	ImageWriter() {}
-	~ImageWriter() {}
+	ImageWriter(const ImageWriter&) = delete;
+	~ImageWriter();
+	ImageWriter& operator=(const ImageWriter&) = delete;
 	bool write(const Image&, const std::string&, const ImageFormat);
+	bool begin(const std::string&, const ImageFormat, const int, const int);
+	bool writeRow(const Color*);
+	bool end(void);
+private:
+	std::vector<unsigned char> staging;	// reused by the writers between saves
+	FileHelper::ImgWriterBase* stream = nullptr;	// image being written
 };
 
 
-// DNA file format: VERTEX_COUNT POLYGON_COUNT R G B A X0 Y0 X1 Y1 ... XN YN ... R G B A X0 Y0 X1 Y1 ... XN YN ...
-DNA readDNA(const std::string&, std::string&);
-bool writeDNA(const DNA&, const std::string&);
+// DNA text format: VERTEX_COUNT POLYGON_COUNT R G B A X0 Y0 X1 Y1 ... XN YN ... R G B A X0 Y0 X1 Y1 ... XN YN ...
+// VERTEX_COUNT 0 means each polygon has its own: 0 POLYGON_COUNT N R G B A X0 Y0 ... XN YN ... N R G B A ...
+// DNA binary format, little-endian: "IIDN" u16 version, u16 flags, u32 VERTEX_COUNT, u32 POLYGON_COUNT,
+// per polygon: [u16 N if flag 1 (VERTEX_COUNT 0)] u8 R G B, u8 0, f32 A, i32 X Y per vertex,
+// then u32 FNV-1a checksum of all preceding bytes
+enum class DNAFormat {NONE, TEXT, BINARY};
+std::string DNAFormatToExtension(const DNAFormat);
+DNAFormat extensionToDNAFormat(const std::string&);
+DNA readDNA(const std::string&, std::string&);	// either format
+bool writeDNA(const DNA&, const std::string&, const DNAFormat = DNAFormat::TEXT);
 
 
 namespace FileHelper {
@@ -68,6 +95,21 @@ namespace FileHelper {
 
 bool isUInt(const std::string&);
 bool isSimpleFloat(const std::string&);
+std::uint32_t checksum(const unsigned char*, const std::size_t);
+DNA readDNAText(const unsigned char*, const std::size_t, std::string&);
+DNA readDNABinary(const unsigned char*, const std::size_t, std::string&);
+bool writeDNAText(const DNA&, const std::string&);
+bool writeDNABinary(const DNA&, const std::string&);
+void encodeDNABinary(const DNA&, std::vector<unsigned char>&);
+
+
+// binary DNA header
+namespace DNABinary {
+	constexpr char magic[4] = {'I', 'I', 'D', 'N'};
+	constexpr std::uint16_t version = 1;
+	constexpr std::uint16_t vertexCounts = 1;	// flag: per polygon vertex counts
+	constexpr std::size_t headerSize = 16;
+}
 
 
 class FileReader {
@@ -105,6 +147,95 @@ private:
 };
 
 
+// reads numbers in place from a text buffer, keeping the line and column of
+// the last token for error messages
+class TextScanner {
+public:
+	TextScanner(const unsigned char*, const std::size_t);
+	bool atEnd(void);
+	bool readUInt(std::size_t&);
+	bool readFloat(float&);
+	std::string position(void) const;
+private:
+	void skipSpace(void);
+
+	const unsigned char* p;
+	const unsigned char* const last;
+	const unsigned char* lineStart;
+	const unsigned char* token;	// start of the last token
+	int line = 1;
+};
+
+
+// read-only view of a whole file: mmap'ed where available, else read in one call
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	~MappedFile();
+	MappedFile& operator=(const MappedFile&) = delete;
+	bool open(const std::string&, const bool = true);
+	void close(void);
+	void release(const std::size_t, const std::size_t) const;
+	const unsigned char* data(void) const;
+	std::size_t size(void) const;
+private:
+	const unsigned char* ptr = nullptr;
+	std::size_t length = 0;
+	bool mapped = false;
+	std::vector<unsigned char> buffer;	// used if not mapped
+};
+
+
+// writes to a temporary file that replaces path on commit, so a crash or a
+// concurrent reader never sees a partially written file
+class AtomicFile {
+public:
+	AtomicFile() = default;
+	AtomicFile(const AtomicFile&) = delete;
+	~AtomicFile();
+	AtomicFile& operator=(const AtomicFile&) = delete;
+	bool open(const std::string&);
+	bool write(const void*, const std::size_t);
+	bool commit(void);
+private:
+	void discard(void);
+
+	std::FILE* f = nullptr;
+	std::string path;
+	std::string tmpPath;
+};
+
+
+// binary ppm (P6) and pgm (P5) rows converted one at a time, so images too
+// large to hold can be streamed; maxval up to 65535, header comments allowed
+class PPMRows {
+public:
+	PPMRows() = default;
+	PPMRows(const PPMRows&) = delete;
+	~PPMRows() = default;
+	PPMRows& operator=(const PPMRows&) = delete;
+	bool open(const std::string&);
+	int width(void) const;
+	int height(void) const;
+	void read(const int, Color*) const;
+	void release(const int) const;
+	const std::string& getError(void) const;
+private:
+	static const unsigned char* skipSpace(const unsigned char*, const unsigned char*);
+	static const unsigned char* readNumber(const unsigned char*, const unsigned char*, std::size_t&);
+
+	MappedFile file;
+	const unsigned char* pixels = nullptr;
+	std::size_t rowBytes = 0;
+	int w = 0;
+	int h = 0;
+	int channels = 0;
+	int maxColor = 0;
+	std::string error;
+};
+
+
 class ImgReaderBase {
 	friend ImageReader;
 public:
@@ -121,32 +252,98 @@ protected:
 };
 
 
+// begin() the file, then writeRow() every row and end() to commit it
 class ImgWriterBase {
 public:
 	virtual ~ImgWriterBase() {}
-	virtual bool write(const Image&, const std::string&) = 0;
+	virtual bool begin(const std::string&, const int, const int) = 0;
+	virtual bool writeRow(const Color*) = 0;
+	virtual bool end(void) = 0;
 protected:
-	ImgWriterBase() {}
+	ImgWriterBase(std::vector<unsigned char>& staging) : staging(staging) {}
+
+	std::vector<unsigned char>& staging;
 };
 
 
-// used to read a generated ppm file
+// reads binary ppm (P6) and pgm (P5), see PPMRows
 class readPPM : public ImgReaderBase {
 public:
 	readPPM() = default;
 	readPPM(const readPPM&) = delete;
 	~readPPM() = default;
 	bool read(const std::string&) override;
-private:
-	static constexpr int limitMB = 10;
 };
 
 
+// rows are gathered in the staging buffer and written in large blocks
 class writePPM : public ImgWriterBase {
 public:
-	writePPM() = default;
+	writePPM(std::vector<unsigned char>& staging) : ImgWriterBase(staging) {}
 	~writePPM() = default;
-	bool write(const Image&, const std::string&) override;
+	bool begin(const std::string&, const int, const int) override;
+	bool writeRow(const Color*) override;
+	bool end(void) override;
+private:
+	static constexpr std::size_t blockSize = 1 << 20;
+	AtomicFile f;
+	std::size_t rowBytes = 0;
+	std::size_t used = 0;	// bytes of staging
+};
+
+
+// "Quite OK Image" format: lossless, byte oriented, much smaller than ppm.
+// Alpha is dropped on read and written as opaque.
+namespace QOI {
+	// chunk tags
+	constexpr unsigned char index = 0x00;
+	constexpr unsigned char diff = 0x40;
+	constexpr unsigned char luma = 0x80;
+	constexpr unsigned char run = 0xc0;
+	constexpr unsigned char rgb = 0xfe;
+	constexpr unsigned char rgba = 0xff;
+	constexpr unsigned char mask = 0xc0;
+	constexpr std::size_t headerSize = 14;
+	constexpr unsigned char end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+	struct Pixel {
+		bool operator==(const Pixel& p) const {return r == p.r && g == p.g && b == p.b && a == p.a;}
+		int hash(void) const {return (r * 3 + g * 5 + b * 7 + a * 11) % 64;}
+
+		unsigned char r, g, b, a;
+	};
+}
+
+
+class readQOI : public ImgReaderBase {
+public:
+	readQOI() = default;
+	readQOI(const readQOI&) = delete;
+	~readQOI() = default;
+	bool read(const std::string&) override;
+private:
+	static std::uint32_t readBE32(const unsigned char*);
+};
+
+
+class writeQOI : public ImgWriterBase {
+public:
+	writeQOI(std::vector<unsigned char>& staging) : ImgWriterBase(staging) {}
+	~writeQOI() = default;
+	bool begin(const std::string&, const int, const int) override;
+	bool writeRow(const Color*) override;
+	bool end(void) override;
+private:
+	static void writeBE32(unsigned char*, const std::uint32_t);
+	static constexpr std::size_t blockSize = 1 << 20;
+	AtomicFile f;
+	int width = 0;
+	std::size_t rowBytes = 0;	// worst case
+	std::size_t used = 0;	// bytes of staging
+	// encoder state, carried across rows
+	QOI::Pixel cache[64] = {};
+	QOI::Pixel prev{0, 0, 0, 255};
+	int run = 0;
 };
 
 
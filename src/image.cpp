@@ -1,22 +1,45 @@
 #include "image.h"
+#include <algorithm>
 
 
-Image::Image(const int w, const int h) {
+template <class Pixel>
+BasicImage<Pixel>::BasicImage(const int w, const int h) {
 	allocate(w, h);
 }
 
 
-Image::Image(const Image& img) : Image(img.width(), img.height()) {
+template <class Pixel>
+BasicImage<Pixel>::BasicImage(const BasicImage& img) : BasicImage(img.width(), img.height()) {
 	copy(img);
 }
 
 
-Image::~Image() {
+template <class Pixel>
+BasicImage<Pixel>::BasicImage(BasicImage&& img) {
+	swap(img);
+}
+
+
+// converts each pixel (Gray8 from Color by luma, Color from Gray8 as gray)
+template <class Pixel>
+template <class Other>
+BasicImage<Pixel>::BasicImage(const BasicImage<Other>& img) : BasicImage(img.width(), img.height()) {
+	for (int y = 0; y < HEIGHT; ++y) {
+		const Other* src = img.row(y);
+		for (int x = 0; x < WIDTH; ++x)
+			data[y][x] = Pixel(src[x]);
+	}
+}
+
+
+template <class Pixel>
+BasicImage<Pixel>::~BasicImage() {
 	clear();
 }
 
 
-Image& Image::operator=(const Image& img) {
+template <class Pixel>
+BasicImage<Pixel>& BasicImage<Pixel>::operator=(const BasicImage& img) {
 	if (WIDTH != img.width() || HEIGHT != img.height()) {
 		clear();
 		allocate(img.width(), img.height());
@@ -26,7 +49,15 @@ Image& Image::operator=(const Image& img) {
 }
 
 
-void Image::resize(const int w, const int h) {
+template <class Pixel>
+BasicImage<Pixel>& BasicImage<Pixel>::operator=(BasicImage&& img) {
+	swap(img);
+	return *this;
+}
+
+
+template <class Pixel>
+void BasicImage<Pixel>::resize(const int w, const int h) {
 	if (w == WIDTH && h == HEIGHT)
 		return;
 
@@ -35,7 +66,8 @@ void Image::resize(const int w, const int h) {
 }
 
 
-Color Image::get(const int x, const int y) const {
+template <class Pixel>
+Pixel BasicImage<Pixel>::get(const int x, const int y) const {
 	if (x < WIDTH && y < HEIGHT)
 		return getRef(x, y);
 	else
@@ -43,7 +75,8 @@ Color Image::get(const int x, const int y) const {
 }
 
 
-void Image::set(const int x, const int y, const Color& c) {
+template <class Pixel>
+void BasicImage<Pixel>::set(const int x, const int y, const Pixel& c) {
 	if (x < WIDTH && y < HEIGHT) {
 		getRef(x, y) = c;
 	}
@@ -52,22 +85,40 @@ void Image::set(const int x, const int y, const Color& c) {
 }
 
 
-int Image::width() const {
+// contiguous pixels of row y (unchecked)
+template <class Pixel>
+const Pixel* BasicImage<Pixel>::row(const int y) const {
+	return data[y];
+}
+
+
+template <class Pixel>
+Pixel* BasicImage<Pixel>::row(const int y) {
+	return data[y];
+}
+
+
+template <class Pixel>
+int BasicImage<Pixel>::width() const {
 	return WIDTH;
 }
 
 
-int Image::height() const {
+template <class Pixel>
+int BasicImage<Pixel>::height() const {
 	return HEIGHT;
 }
 
 
-bool Image::empty() const {
-	return data == nullptr;
+// no pixels (a copy of a 0 x 0 image still holds an allocation)
+template <class Pixel>
+bool BasicImage<Pixel>::empty() const {
+	return WIDTH == 0 || HEIGHT == 0;
 }
 
 
-void Image::clear() {
+template <class Pixel>
+void BasicImage<Pixel>::clear() {
 	if (data != nullptr)
 		deallocate(data, HEIGHT);
 
@@ -77,22 +128,34 @@ void Image::clear() {
 }
 
 
-void Image::allocate(const int w, const int h) {
+// exchanges pixel buffers without copying
+template <class Pixel>
+void BasicImage<Pixel>::swap(BasicImage& img) {
+	std::swap(data, img.data);
+	std::swap(WIDTH, img.WIDTH);
+	std::swap(HEIGHT, img.HEIGHT);
+}
+
+
+template <class Pixel>
+void BasicImage<Pixel>::allocate(const int w, const int h) {
 	data = getAllocation(w, h);
 	WIDTH = w;
 	HEIGHT = h;
 }
 
 
-Color** Image::getAllocation(const int width, const int height) {
-	Color** ptr = new Color*[height];
+template <class Pixel>
+Pixel** BasicImage<Pixel>::getAllocation(const int width, const int height) {
+	Pixel** ptr = new Pixel*[height];
 	for (int i = 0; i < height; ++i)
-		ptr[i] = new Color[width];
+		ptr[i] = new Pixel[width];
 	return ptr;
 }
 
 
-void Image::deallocate(Color** ptr, const int height) {
+template <class Pixel>
+void BasicImage<Pixel>::deallocate(Pixel** ptr, const int height) {
 	for (int h = 0; h < height; ++h) {
 		delete[] ptr[h];
 		ptr[h] = nullptr;
@@ -101,21 +164,27 @@ void Image::deallocate(Color** ptr, const int height) {
 }
 
 
-void Image::copy(const Image& img) {
-	for (int x = 0; x < img.width(); ++x) {
-		for (int y = 0; y < img.height(); ++y) {
-			getRef(x, y) = img.get(x, y);
-		}
-	}
+template <class Pixel>
+void BasicImage<Pixel>::copy(const BasicImage& img) {
+	for (int y = 0; y < img.height(); ++y)
+		std::copy(img.data[y], img.data[y] + img.width(), data[y]);
 }
 
 
-Color& Image::getRef(const int x, const int y) {
+template <class Pixel>
+Pixel& BasicImage<Pixel>::getRef(const int x, const int y) {
 	return data[y][x];
 }
 
 
 
-const Color& Image::getRef(const int x, const int y) const {
+template <class Pixel>
+const Pixel& BasicImage<Pixel>::getRef(const int x, const int y) const {
 	return data[y][x];
 }
+
+
+template class BasicImage<Color>;
+template class BasicImage<Gray8>;
+template BasicImage<Color>::BasicImage(const BasicImage<Gray8>&);
+template BasicImage<Gray8>::BasicImage(const BasicImage<Color>&);
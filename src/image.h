@@ -2,32 +2,45 @@
 
 #include "color.h"
 #include <stdexcept>
+#include <utility>
 
 
-class Image {
+// Pixel is Color (RGB) or Gray8, instantiated in image.cpp
+template <class Pixel>
+class BasicImage {
 public:
-	Image() = default;
-	Image(const Image&);
-	Image(const int, const int);
-	~Image();
-	Image& operator=(const Image&);
+	BasicImage() = default;
+	BasicImage(const BasicImage&);
+	BasicImage(BasicImage&&);
+	template <class Other> explicit BasicImage(const BasicImage<Other>&);
+	BasicImage(const int, const int);
+	~BasicImage();
+	BasicImage& operator=(const BasicImage&);
+	BasicImage& operator=(BasicImage&&);
 
 	void resize(const int, const int);
-	Color get(const int, const int) const;
-	void set(const int, const int, const Color&);
+	Pixel get(const int, const int) const;
+	void set(const int, const int, const Pixel&);
+	const Pixel* row(const int) const;
+	Pixel* row(const int);
 	int width(void) const;
 	int height(void) const;
 	bool empty(void) const;
 	void clear(void);
+	void swap(BasicImage&);
 private:
 	void allocate(const int, const int);
-	static Color** getAllocation(const int, const int);
-	static void deallocate(Color**, const int);
-	void copy(const Image&);
-	Color& getRef(const int, const int);
-	const Color& getRef(const int, const int) const;
+	static Pixel** getAllocation(const int, const int);
+	static void deallocate(Pixel**, const int);
+	void copy(const BasicImage&);
+	Pixel& getRef(const int, const int);
+	const Pixel& getRef(const int, const int) const;
 
-	Color** data = nullptr;
+	Pixel** data = nullptr;
 	int WIDTH = 0;
 	int HEIGHT = 0;
 };
+
+
+typedef BasicImage<Color> Image;
+typedef BasicImage<Gray8> GrayImage;
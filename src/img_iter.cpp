@@ -1,25 +1,53 @@
 #include "img_iter.h"
 
 
-img_iter::img_iter(const Image& img, const int pc, const int vc, bool dummy)
-: background(255, 255, 255), original(img), canvas(img.width(), img.height()),
-  pm(pc, vc, img.width(), img.height()), maxAccuracy(getMaxAccuracy(img)),
-  blockCountX(img.width() % blockSize == 0 ? img.width() / blockSize : img.width() / blockSize + 1),
-  blockCountY(img.height() % blockSize == 0 ? img.height() / blockSize : img.height() / blockSize + 1) {
-	(void)dummy;
+template <class Pixel>
+constexpr float basic_img_iter<Pixel>::fitAlphas[];
+template <class Pixel>
+constexpr int basic_img_iter<Pixel>::searchSteps[];
+
+
+// w x h with an empty original and no polygons
+template <class Pixel>
+basic_img_iter<Pixel>::basic_img_iter(const int w, const int h, const int pc, const int vc, TaskScheduler& ts, const std::uint64_t seed)
+: background(255, 255, 255), original(w, h, blockSize), best(w, h, blockSize), canvas(w, h, blockSize),
+  pm(vc, w, h, seed), scheduler(ts), maxAccuracy(getMaxAccuracy(w, h)),
+  blockCountX(w % blockSize == 0 ? w / blockSize : w / blockSize + 1),
+  blockCountY(h % blockSize == 0 ? h / blockSize : h / blockSize + 1),
+  errors(w, h, blockSize) {
 	polygons.reserve(pc);
+	setGrowth(0, 0);
+	if (std::is_same<Pixel, Gray8>::value) {
+		// colors are drawn as their luma, so only gray ones are proposed
+		pm.setGray(true);
+		pm.operators().setEnabled(static_cast<int>(Mutation::G), false);
+		pm.operators().setEnabled(static_cast<int>(Mutation::B), false);
+	}
 	blocks.reserve(blockCountX);
 	for (int i = 0; i < blockCountX; ++i) {
 		blocks.emplace_back();
 		blocks[i].reserve(blockCountY);
-		for (int j = 0; j < blockCountY; ++j)
+		for (int j = 0; j < blockCountY; ++j) {
 			blocks[i].emplace_back();
+			const int bw = std::min((i + 1) * blockSize, w) - i * blockSize;
+			const int bh = std::min((j + 1) * blockSize, h) - j * blockSize;
+			blocks[i].back().maxAcc = bw * bh;
+		}
 	}
 }
 
 
-img_iter::img_iter(const Image& img, const int pc, const int vc)
-: img_iter(img, pc, vc, true) {
+template <class Pixel>
+basic_img_iter<Pixel>::basic_img_iter(const Image& img, const int pc, const int vc, TaskScheduler& ts, const std::uint64_t seed, bool dummy)
+: basic_img_iter(img.width(), img.height(), pc, vc, ts, seed) {
+	(void)dummy;
+	original.assign(img);
+}
+
+
+template <class Pixel>
+basic_img_iter<Pixel>::basic_img_iter(const Image& img, const int pc, const int vc, TaskScheduler& ts, const std::uint64_t seed)
+: basic_img_iter(img, pc, vc, ts, seed, true) {
 	for (int i = 0; i < pc; ++i) {
 		polygons.emplace_back(pm);
 		polygons.back().setIndex(i);
@@ -28,8 +56,11 @@ img_iter::img_iter(const Image& img, const int pc, const int vc)
 }
 
 
-img_iter::img_iter(const Image& img, const DNA& d)
-: img_iter(img, d.polyCount, d.vertCount, true) {
+// DNA with a variable vertex count (vertCount 0) adds polygons with as many
+// vertices as its first
+template <class Pixel>
+basic_img_iter<Pixel>::basic_img_iter(const Image& img, const DNA& d, TaskScheduler& ts, const std::uint64_t seed)
+: basic_img_iter(img, d.polyCount, d.vertCount > 0 ? d.vertCount : d.data.front().v.size(), ts, seed, true) {
 	int i = 0;
 	for (auto it = d.data.begin(); it != d.data.end(); ++it, ++i) {
 		polygons.emplace_back(pm, *it);
@@ -39,27 +70,13 @@ img_iter::img_iter(const Image& img, const DNA& d)
 }
 
 
-void img_iter::init() {
-	// draw polygons on canvas
-	canvas.clear(background);
-	for (auto it = polygons.cbegin(); it != polygons.cend(); ++it) {
-		canvas.setColor((*it).getColor());
-		canvas.setAlpha((*it).getAlpha());
-		canvas.fill((*it).getPolygon());
-	}
-	// copy canvas to best
-	best = canvas.getImage();
-	// set block accuracy
-	for (int i = 0; i < blockCountX; ++i) {
-		for (int j = 0; j < blockCountY; ++j) {
-			blocks[i][j].acc = blockAccuracy(i, j);
-		}
-	}
-	fit = getFitness();
-	// set block polygon order
+template <class Pixel>
+void basic_img_iter<Pixel>::init() {
+	// set block polygon order (fill details are cached for concurrent drawing)
 	BlockGroup bg;
 	for (auto it = polygons.begin(); it != polygons.end(); ++it) {
 		const auto index = (*it).getIndex();
+		(*it).getPolygon().fillDetails();
 		intersectIndex((*it).getBounds(), bg);
 		for (int i = bg.iLo; i <= bg.iHi; ++i) {
 			for (int j = bg.jLo; j <= bg.jHi; ++j)
@@ -67,154 +84,865 @@ void img_iter::init() {
 		}
 	}
 	assert(validBlocks());
+	// draw blocks to best and set their accuracy
+	auto setBlock = [this] (const int i, const int j) {
+		drawBlock(i, j);
+		copyBlock(Index2D(i, j));
+		blocks[i][j].acc = blockAccuracy(i, j);
+	};
+	forEachBlock(setBlock);
+	fit = getFitness();
+	updateView();
 
 	start = std::chrono::high_resolution_clock::now();
 }
 
 
 // assumes all vertices are >= 0
-void img_iter::iterate() {
+template <class Pixel>
+void basic_img_iter<Pixel>::iterate() {
 	++iter;
-	BlockGroup bg;
+	const Mutation m = pm.randMutation();
+	const bool added = (m == Mutation::Add);
+	if ((added && polygons.size() >= static_cast<std::size_t>(maxPolygons)) ||
+	    (m == Mutation::Remove && polygons.size() < 2)) {
+		pm.reportMutation(m, false, 0);	// no room to grow or shrink
+		return;
+	}
+	if (added)
+		addPolygon();
+	IterPoly& ip = added ? polygons.back() : polygons[randPolyIndex()];
+	if ((m == Mutation::AddVert && ip.getPolygon().size() >= static_cast<std::size_t>(maxVertices)) ||
+	    (m == Mutation::RemoveVert && ip.getPolygon().size() <= 3)) {
+		pm.reportMutation(m, false, 0);
+		return;
+	}
+
+	BlockGroup bg1;	// blocks of ip before mutation
+	BlockGroup bg2;	// blocks of ip after mutation
 	std::set<Index2D> changes;	// changed blocks from this iteration
-	IterPoly& ip = polygons[pm.randPolyIndex()];
-	Rectangle bounds1{ip.getBounds()};
-	intersectIndex(bounds1, bg);
-	addBlockSet(changes, bg);
-	ip.mutate();
-	const bool sizeMutation = sizeChange(ip.lastMutation());
-	Rectangle bounds2{ip.getBounds()};
-	if (sizeMutation) {
-		updateBlockPolygon(bg, ip, false);	// remove poly from original blocks
-		intersectIndex(bounds2, bg);
-		updateBlockPolygon(bg, ip, true);	// add poly to new blocks
-
-		addBlockSet(changes, bg);
+	intersectIndex(ip.getBounds(), bg1);
+	const bool sizeMutation = sizeChange(m);
+	IterPoly* other = nullptr;	// swapped with ip
+	std::size_t setupCost = 0;	// blocks drawn to choose Fit or Search
+	if (m == Mutation::Swap) {
+		other = &swapPartner(ip, bg1);
+		intersectIndex(other->getBounds(), bg2);
+		addSwapBlocks(changes, ip.getIndex(), other->getIndex(), bg1, bg2);
+		ip.swap(*other);
+		// each index now holds the other's polygon
+		updateBlockPolygon(ip.getIndex(), bg1, bg2);
+		updateBlockPolygon(other->getIndex(), bg2, bg1);
+	}
+	else {
+		addBlockSet(changes, bg1);
+		if (m == Mutation::Fit) {
+			Color c;
+			float a;
+			fitColor(ip, bg1, c, a);
+			setupCost = 3 * changes.size();
+			ip.recolor(c, a);
+		}
+		else if (m == Mutation::Search) {
+			std::size_t v;
+			Point to;
+			setupCost = searchVertex(ip, v, to);
+			ip.moveVert(v, to);
+		}
+		else if (!added) {
+			ip.mutate(m);
+		}
+		ip.getPolygon().fillDetails();	// build fill cache before blocks are drawn concurrently
+		if (sizeMutation) {
+			intersectIndex(ip.getBounds(), bg2);
+			updateBlockPolygon(ip.getIndex(), bg1, bg2);
+			addBlockSet(changes, bg2);
+		}
 	}
 	
+	std::vector<Index2D> changed{changes.cbegin(), changes.cend()};
+	bool screened = false;	// rejected by pre-screen
+	bool exact = true;	// evaluate exactly
+	float cost = setupCost;	// blocks evaluated
+	if (prescreenStride > 0 && !changed.empty()) {
+		++ps.checks;
+		cost += static_cast<float>(changed.size()) / prescreenStride;
+		if (prescreenReject(changed)) {
+			screened = true;
+			++ps.rejects;
+			exact = (ps.rejects % auditInterval == 0);
+			if (exact)
+				++ps.audits;
+		}
+	}
+
 	// draw and recalc fitness of changed blocks
-	float old_acc_sum = 0;
-	float new_acc_sum = 0;
 	std::vector<float> new_acc;
-	new_acc.reserve(changes.size());
-	for (auto it = changes.cbegin(); it != changes.cend(); ++it) {
-		drawBlock((*it).first, (*it).second);
-		old_acc_sum += blocks[(*it).first][(*it).second].acc;
-		new_acc.push_back(blockAccuracy((*it).first, (*it).second));
-		new_acc_sum += new_acc.back();
-	}
+	int drawn = 0;
+	const bool improved = exact && evaluate(changed, new_acc, drawn);
+	cost += drawn;
+	pm.reportMutation(m, improved, cost);
+	if (screened && improved)
+		++ps.wrong;
+	else if (prescreenStride > 0 && !screened && !improved && !changed.empty())
+		++ps.passedWorse;
 
-	if (new_acc_sum > old_acc_sum) {	// improvement
+	if (improved) {
 		++imp;
 		// set new fitness of changed blocks and copy blocks to best
-		int i = 0;
-		for (auto it = changes.cbegin(); it != changes.cend(); ++it, ++i) {
-			blocks[(*it).first][(*it).second].acc = new_acc[i];
-			copyBlock(best, canvas, *it);
+		for (std::size_t i = 0; i < changed.size(); ++i) {
+			blocks[changed[i].first][changed[i].second].acc = new_acc[i];
+			copyBlock(changed[i]);
+			updateView(changed[i]);
+			if (sampled())
+				errors.set(changed[i].first, changed[i].second, headroom(changed[i]));
 		}
-		fit = getFitness();		
+		fit = getFitness();
+		if (journal != nullptr)
+			journalMutation(m, ip, other);
+		if (m == Mutation::Remove)
+			removePolygon(ip.getIndex());
+		if (journal != nullptr && journal->keyframeDue())
+			journal->keyframe(imp, getDNA());
+	}
+	else if (added) {
+		indexPolygon(ip.getIndex(), bg1, false);
+		polygons.pop_back();
 	}
 	else {
-		if (sizeMutation) {
-			intersectIndex(bounds2, bg);
-			updateBlockPolygon(bg, ip, false);	// remove poly from new blocks
-			intersectIndex(bounds1, bg);
-			updateBlockPolygon(bg, ip, true);	// add poly to original blocks
+		if (other != nullptr) {
+			updateBlockPolygon(ip.getIndex(), bg2, bg1);
+			updateBlockPolygon(other->getIndex(), bg1, bg2);
+		}
+		else if (sizeMutation) {
+			updateBlockPolygon(ip.getIndex(), bg2, bg1);
 		}
 		ip.undo();
+		ip.getPolygon().fillDetails();
 	}
 
+	trimTiles();
 	assert(validBlocks());
 }
 
 
 // iterate until improvement has been made
-void img_iter::improve() {
+template <class Pixel>
+void basic_img_iter<Pixel>::improve() {
 	const auto improvements = imp;
 	while (imp == improvements)
 		iterate();
 }
 
 
-int img_iter::iterations() const {
+template <class Pixel>
+int basic_img_iter<Pixel>::iterations() const {
 	return iter;
 }
 
 
-int img_iter::improvements() const {
+template <class Pixel>
+int basic_img_iter<Pixel>::improvements() const {
 	return imp;
 }
 
 
-float img_iter::fitness() const {
+template <class Pixel>
+float basic_img_iter<Pixel>::fitness() const {
 	return fit;
 }
 
 
 // time (seconds) since constructor called
-int img_iter::runtime() const {
+template <class Pixel>
+int basic_img_iter<Pixel>::runtime() const {
 	return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::high_resolution_clock::now()-start).count();
 }
 
 
 // copy of best image
-Image img_iter::getImage() const {
-	return best;
+template <class Pixel>
+Image basic_img_iter<Pixel>::getImage() const {
+	return Image{best.getImage()};
+}
+
+
+// reference to improving image (for Viewer), kept up to date from the first
+// call on (not when tiled)
+template <class Pixel>
+const Image& basic_img_iter<Pixel>::bestImage() const {
+	assert(!tiledMode);
+	if (!viewed) {
+		viewed = true;
+		updateView();
+	}
+	return view;
+}
+
+
+// score every stride-th row of changed blocks before exact evaluation
+// candidates worse than the incumbent by more than margin (per sampled pixel) are rejected
+template <class Pixel>
+void basic_img_iter<Pixel>::setPrescreen(const int stride, const float margin) {
+	prescreenStride = stride;
+	prescreenMargin = margin;
+}
+
+
+template <class Pixel>
+const PrescreenStats& basic_img_iter<Pixel>::prescreenStats() const {
+	return ps;
+}
+
+
+// choose polygons and vertex positions by block error instead of uniformly
+// (always on while weighted)
+template <class Pixel>
+void basic_img_iter<Pixel>::setGuided(const bool g) {
+	guided = g;
+	if (sampled()) {
+		for (int i = 0; i < blockCountX; ++i) {
+			for (int j = 0; j < blockCountY; ++j)
+				errors.set(i, j, headroom(Index2D(i, j)));
+		}
+		pm.setSampler(&errors);
+	}
+	else {
+		pm.setSampler(nullptr);
+	}
+}
+
+
+// reweight mutation operators by their acceptance rate per block evaluated
+template <class Pixel>
+void basic_img_iter<Pixel>::setAdaptive(const bool a) {
+	pm.operators().setAdaptive(a);
+}
+
+
+template <class Pixel>
+const OperatorSelector& basic_img_iter<Pixel>::operatorStats() const {
+	return pm.operators();
+}
+
+
+// score with metric m from now on
+template <class Pixel>
+void basic_img_iter<Pixel>::setMetric(const Metric m) {
+	if (m == metric.type())
+		return;
+	metric = FitnessMetric{m};
+	rescore();
+}
+
+
+// Weight each pixel's accuracy by the luma of the same pixel of w (black
+// pixels are ignored). Mutations are then sampled by block error as with
+// setGuided(true), and since block headroom shrinks with its weight, low
+// weight blocks are visited less. Returns false, leaving the
+// weights unchanged, if w is the wrong size or entirely black.
+template <class Pixel>
+bool basic_img_iter<Pixel>::setWeights(const Image& w) {
+	if (w.width() != original.width() || w.height() != original.height())
+		return false;
+	PixelImage gray{w.width(), w.height()};
+	std::uint64_t total = 0;
+	for (int y = 0; y < w.height(); ++y) {
+		for (int x = 0; x < w.width(); ++x) {
+			const Color c{w.get(x, y)};
+			const int g = (77 * c.R + 150 * c.G + 29 * c.B) >> 8;
+			gray.set(x, y, Pixel(Color(g, g, g)));
+			total += g;
+		}
+	}
+	if (total == 0)
+		return false;
+	weights = std::make_shared<const PixelImage>(std::move(gray));
+	maxAccuracy = 0;
+	for (int i = 0; i < blockCountX; ++i) {
+		const int x0 = i * blockSize;
+		const int n = std::min((i + 1) * blockSize, original.width()) - x0;
+		for (int j = 0; j < blockCountY; ++j) {
+			std::uint64_t sum = 0;
+			const int yLim = std::min((j + 1) * blockSize, original.height());
+			for (int y = j * blockSize; y < yLim; ++y)
+				sum += rowWeight(weights->row(y) + x0, n);
+			blocks[i][j].maxAcc = static_cast<float>(sum) / 255;
+			maxAccuracy += blocks[i][j].maxAcc;
+		}
+	}
+	rescore();
+	return true;
+}
+
+
+// recompute block accuracy of the best image after the scoring changed
+template <class Pixel>
+void basic_img_iter<Pixel>::rescore() {
+	auto work = [this] (const int i, const int j) {
+		blocks[i][j].acc = blockAccuracy(i, j, best);
+	};
+	forEachBlock(work);
+	fit = getFitness();
+	setGuided(guided);
+}
+
+
+// Allow up to maxPolys polygons and maxVerts vertices per polygon, growing and
+// shrinking by the Add, Remove, AddVert and RemoveVert mutations (0 keeps the
+// counts fixed).
+template <class Pixel>
+void basic_img_iter<Pixel>::setGrowth(const int maxPolys, const int maxVerts) {
+	maxPolygons = maxPolys;
+	maxVertices = maxVerts;
+	polygons.reserve(std::max<std::size_t>(polygons.size(), maxPolygons));
+	OperatorSelector& ops = pm.operators();
+	ops.setEnabled(static_cast<int>(Mutation::Add), maxPolygons > 0);
+	ops.setEnabled(static_cast<int>(Mutation::Remove), maxPolygons > 0);
+	ops.setEnabled(static_cast<int>(Mutation::AddVert), maxVertices > 0);
+	ops.setEnabled(static_cast<int>(Mutation::RemoveVert), maxVertices > 0);
+}
+
+
+// records accepted mutations from now on, starting with a keyframe
+template <class Pixel>
+void basic_img_iter<Pixel>::setJournal(Journal* j) {
+	journal = j;
+	if (journal != nullptr)
+		journal->keyframe(imp, getDNA());
 }
 
 
-// reference to improving image (for Viewer)
-const Image& img_iter::bestImage() const {
-	return best;
+template <class Pixel>
+int basic_img_iter<Pixel>::polygonCount() const {
+	return polygons.size();
+}
+
+
+template <class Pixel>
+bool basic_img_iter<Pixel>::tiled() const {
+	return tiledMode;
+}
+
+
+// Header (pixel type, size, vertex count of new polygons, polygon count),
+// then the settings, counters, random state, polygons, block index and
+// accuracies and error sampler. The best image and weights follow from
+// ImageSnapshot::checkpoint() of a snapshot() taken at the same time. The
+// canvas is not saved: blocks are always redrawn before they are read.
+template <class Pixel>
+void basic_img_iter<Pixel>::checkpoint(CheckpointWriter& w) const {
+	w.put8(std::is_same<Pixel, Gray8>::value);
+	w.put32(original.width());
+	w.put32(original.height());
+	w.put32(pm.vertexCount());
+	w.put32(polygons.size());
+
+	w.put8(static_cast<std::uint8_t>(metric.type()));
+	w.put32(prescreenStride);
+	w.putFloat(prescreenMargin);
+	w.put8(guided);
+	w.put32(maxPolygons);
+	w.put32(maxVertices);
+	w.put32(iter);
+	w.put32(imp);
+	w.putFloat(fit);
+	w.putFloat(maxAccuracy);
+	w.put64(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count());
+	w.put32(ps.checks);
+	w.put32(ps.rejects);
+	w.put32(ps.audits);
+	w.put32(ps.wrong);
+	w.put32(ps.passedWorse);
+	pm.save(w);
+
+	for (auto it = polygons.cbegin(); it != polygons.cend(); ++it) {
+		const Polygon::Container& v = (*it).getPolygon().vertices();
+		w.put32(v.size());
+		for (auto vit = v.cbegin(); vit != v.cend(); ++vit) {
+			w.put32(static_cast<std::uint32_t>((*vit).x));
+			w.put32(static_cast<std::uint32_t>((*vit).y));
+		}
+		const Color& col = (*it).getColor();
+		w.put8(col.R);
+		w.put8(col.G);
+		w.put8(col.B);
+		w.putFloat((*it).getAlpha());
+	}
+	for (int i = 0; i < blockCountX; ++i) {
+		for (int j = 0; j < blockCountY; ++j) {
+			const Block& b = blocks[i][j];
+			w.putFloat(b.acc);
+			w.putFloat(b.maxAcc);
+			w.put32(b.polygons.size());
+			for (auto it = b.polygons.cbegin(); it != b.polygons.cend(); ++it)
+				w.put32(*it);
+		}
+	}
+	errors.save(w);
+}
+
+
+// best image and weights, null if tiled
+template <class Pixel>
+ImageSnapshot* basic_img_iter<Pixel>::snapshot() const {
+	if (tiledMode)
+		return nullptr;
+	return new BasicImageSnapshot<Pixel>(best, weights);
+}
+
+
+// everything after the header written by checkpoint(), false if the data
+// does not describe a consistent state for this image
+template <class Pixel>
+bool basic_img_iter<Pixel>::load(CheckpointReader& r, const std::size_t pc) {
+	metric = FitnessMetric{static_cast<Metric>(r.get8())};
+	prescreenStride = r.get32();
+	prescreenMargin = r.getFloat();
+	guided = r.get8() != 0;
+	const int maxPolys = r.get32();
+	const int maxVerts = r.get32();
+	iter = r.get32();
+	imp = r.get32();
+	fit = r.getFloat();
+	maxAccuracy = r.getFloat();
+	const std::uint64_t elapsed = r.get64();
+	ps.checks = r.get32();
+	ps.rejects = r.get32();
+	ps.audits = r.get32();
+	ps.wrong = r.get32();
+	ps.passedWorse = r.get32();
+	if (!r.good() || prescreenStride < 0 || maxPolys < 0 || maxVerts < 0)
+		return false;
+	// enables the growth operators, their probabilities are restored next
+	setGrowth(maxPolys, maxVerts);
+	if (!pm.load(r))
+		return false;
+
+	for (std::size_t k = 0; k < pc; ++k) {
+		const std::uint32_t n = r.get32();
+		if (!r.good() || n < 3)
+			return false;
+		Polygon p;
+		for (std::uint32_t v = 0; v < n && r.good(); ++v) {
+			const int x = static_cast<std::int32_t>(r.get32());
+			const int y = static_cast<std::int32_t>(r.get32());
+			if (x < 0 || y < 0)
+				return false;
+			p.add(Point(x, y));
+		}
+		Color col;
+		col.R = r.get8();
+		col.G = r.get8();
+		col.B = r.get8();
+		const float a = r.getFloat();
+		if (!r.good() || !(a >= 0 && a <= 1))
+			return false;
+		polygons.emplace_back(pm, p, col, a);
+		polygons.back().setIndex(k);
+		polygons.back().getPolygon().fillDetails();	// cached before concurrent drawing
+	}
+	for (int i = 0; i < blockCountX; ++i) {
+		for (int j = 0; j < blockCountY; ++j) {
+			Block& b = blocks[i][j];
+			b.acc = r.getFloat();
+			b.maxAcc = r.getFloat();
+			const std::uint32_t n = r.get32();
+			for (std::uint32_t k = 0; k < n && r.good(); ++k) {
+				const std::uint32_t index = r.get32();
+				if (index >= pc)
+					return false;
+				b.polygons.emplace_hint(b.polygons.end(), index);
+			}
+		}
+	}
+	if (!r.good() || !validBlocks() || !errors.load(r))
+		return false;
+	for (int y = 0; y < best.height(); ++y) {
+		for (int i = 0; i < blockCountX; ++i)
+			r.getBytes(best.tile(i, y / blockSize) + (y % blockSize) * blockSize, (std::min((i + 1) * blockSize, best.width()) - i * blockSize) * sizeof(Pixel));
+	}
+	if (r.get8() != 0) {
+		PixelImage gray{original.width(), original.height()};
+		for (int y = 0; y < gray.height(); ++y)
+			r.getBytes(gray.row(y), gray.width() * sizeof(Pixel));
+		weights = std::make_shared<const PixelImage>(std::move(gray));
+	}
+	if (!r.good() || !r.atEnd())
+		return false;
+
+	pm.setSampler(sampled() ? &errors : nullptr);
+	updateView();
+	start = std::chrono::high_resolution_clock::now() - std::chrono::milliseconds(elapsed);
+	return true;
 }
 
 
-DNA img_iter::getDNA() const {
-	DNA d{polygons.size(), polygons.front().getPolygon().size()};
+// vertCount is 0 if polygons have different vertex counts
+template <class Pixel>
+DNA basic_img_iter<Pixel>::getDNA() const {
+	std::size_t vc = polygons.front().getPolygon().size();
+	for (auto it = polygons.cbegin(); it != polygons.cend(); ++it) {
+		if ((*it).getPolygon().size() != vc)
+			vc = 0;
+	}
+	DNA d{polygons.size(), vc};
 	for (auto it = polygons.cbegin(); it != polygons.cend(); ++it)
 		d.add((*it).getPolygon(), (*it).getColor(), (*it).getAlpha());
 	return d;
 }
 
 
-void img_iter::drawBlock(const int i, const int j) {
+template <class Pixel>
+void basic_img_iter<Pixel>::drawBlock(const int i, const int j) {
+	drawBlock(i, j, -1, background, 0);
+}
+
+
+// draw block (i, j) with polygon index 'over' drawn in color c with alpha a
+template <class Pixel>
+void basic_img_iter<Pixel>::drawBlock(const int i, const int j, const int over, const Color& c, const float a) {
 	Rectangle mask;
 	mask.x0 = i * blockSize;
 	mask.y0 = j * blockSize;
 	mask.x1 = std::min(mask.x0 + blockSize - 1, original.width() - 1);
 	mask.y1 = std::min(mask.y0 + blockSize - 1, original.height() - 1);
+	PixelCanvas window{canvas.tile(i, j), blockSize, mask};
 	// reset block
-	canvas.setColor(background);
-	canvas.setAlpha(1.0);
-	canvas.fill(mask);
+	window.fill(mask, background, 1.0);
 	// draw block
 	const auto& block = blocks[i][j];
 	for (auto it = block.polygons.cbegin(); it != block.polygons.cend(); ++it) {
 		const auto& ip = polygons[*it];
-		canvas.setColor(ip.getColor());
-		canvas.setAlpha(ip.getAlpha());
-		canvas.fill(ip.getPolygon(), mask);
+		if (*it == over)
+			window.fill(ip.getPolygon(), mask, c, a);
+		else
+			window.fill(ip.getPolygon(), mask, ip.getColor(), ip.getAlpha());
+	}
+}
+
+
+// Color and alpha (current or one of fitAlphas) of ip that best match the
+// image with its geometry fixed, see ColorFit. Leaves canvas dirty in bg.
+template <class Pixel>
+void basic_img_iter<Pixel>::fitColor(const IterPoly& ip, const BlockGroup& bg, Color& c, float& a) {
+	const Polygon& p = ip.getPolygon();
+	p.fillDetails();
+	std::vector<Color> without;
+	std::vector<Color> black;
+	std::vector<Color> white;
+	drawGroup(bg, ip.getIndex(), background, 0);
+	readCoverage(p, without);
+	drawGroup(bg, ip.getIndex(), Color(0, 0, 0), 1);
+	readCoverage(p, black);
+	drawGroup(bg, ip.getIndex(), Color(255, 255, 255), 1);
+	readCoverage(p, white);
+
+	colorFit.clear();
+	colorFit.reserve(without.size());
+	std::size_t k = 0;
+	const auto& lines = p.fillDetails();
+	for (auto it = lines.cbegin(); it != lines.cend(); ++it) {
+		for (std::size_t s = 0; s + 1 < (*it).xList.size(); s += 2) {
+			for (int x = (*it).xList[s]; x <= (*it).xList[s + 1]; ++x, ++k)
+				colorFit.add(Color(original.get(x, (*it).y)), without[k], black[k], white[k]);
+		}
+	}
+
+	a = ip.getAlpha();
+	c = ip.getColor();
+	if (colorFit.empty())
+		return;
+	float error = colorFit.solve(a, c);
+	for (int i = 0; i < fitAlphaCount; ++i) {
+		Color tmp;
+		const float e = colorFit.solve(fitAlphas[i], tmp);
+		if (e < error) {
+			error = e;
+			c = tmp;
+			a = fitAlphas[i];
+		}
+	}
+}
+
+
+// draw blocks in bg (see drawBlock(i, j, over, c, a))
+template <class Pixel>
+void basic_img_iter<Pixel>::drawGroup(const BlockGroup& bg, const int over, const Color& c, const float a) {
+	const int countY = bg.jHi - bg.jLo + 1;
+	auto work = [this, &bg, countY, over, &c, a] (const int k) {
+		drawBlock(bg.iLo + k / countY, bg.jLo + k % countY, over, c, a);
+	};
+	scheduler.parallelFor(0, (bg.iHi - bg.iLo + 1) * countY, 1, work);
+}
+
+
+// canvas pixels in r, row by row
+template <class Pixel>
+void basic_img_iter<Pixel>::readRect(const Rectangle& r, std::vector<Color>& out) const {
+	out.clear();
+	for (int y = r.y0; y <= r.y1; ++y) {
+		for (int x = r.x0; x <= r.x1; ++x)
+			out.push_back(Color(canvas.get(x, y)));
+	}
+}
+
+
+// Picks a vertex of ip and the best position for it among searchSteps along
+// each axis, returns the number of blocks drawn.
+// The region any candidate can cover is drawn once without ip, with ip opaque
+// black and with it opaque white (see ColorFit), which gives the error change
+// of covering each pixel. A candidate's score is then the sum of that change
+// over its coverage, read from row prefix sums, so each extra position costs a
+// scanline fill instead of a block redraw.
+template <class Pixel>
+std::size_t basic_img_iter<Pixel>::searchVertex(const IterPoly& ip, std::size_t& v, Point& to) {
+	const Polygon& p = ip.getPolygon();
+	v = pm.randVertIndex(p.size());
+	const Point from{p.get(v)};
+	const int reach = searchSteps[searchStepCount - 1];
+	Rectangle region{p.getBounds()};
+	region.x0 = std::max(region.x0 - reach, 0);
+	region.y0 = std::max(region.y0 - reach, 0);
+	region.x1 = std::min(region.x1 + reach, original.width() - 1);
+	region.y1 = std::min(region.y1 + reach, original.height() - 1);
+	BlockGroup bg;
+	intersectIndex(region, bg);
+	std::vector<Color> without;
+	std::vector<Color> black;
+	std::vector<Color> white;
+	drawGroup(bg, ip.getIndex(), background, 0);
+	readRect(region, without);
+	drawGroup(bg, ip.getIndex(), Color(0, 0, 0), 1);
+	readRect(region, black);
+	drawGroup(bg, ip.getIndex(), Color(255, 255, 255), 1);
+	readRect(region, white);
+
+	// prefix sums per row of the error change if a pixel is covered
+	const int w = region.x1 - region.x0 + 1;
+	const int h = region.y1 - region.y0 + 1;
+	const Color& c = ip.getColor();
+	const float a = ip.getAlpha();
+	auto change = [a] (const int t, const int o, const int b, const int wh, const int cc) {
+		const float covered = (1.0f - a) * (o - b) + b + a * (wh - b) / 255.0f * cc;
+		return std::abs(t - covered) - std::abs(t - o);
+	};
+	std::vector<float> prefix((w + 1) * h, 0);
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			const std::size_t k = y * w + x;
+			const Color t{original.get(region.x0 + x, region.y0 + y)};
+			const float d = change(t.R, without[k].R, black[k].R, white[k].R, c.R)
+			              + change(t.G, without[k].G, black[k].G, white[k].G, c.G)
+			              + change(t.B, without[k].B, black[k].B, white[k].B, c.B);
+			prefix[y * (w + 1) + x + 1] = prefix[y * (w + 1) + x] + d;
+		}
+	}
+
+	Polygon candidate{p};
+	float best = 0;
+	bool found = false;
+	to = from;
+	static const int dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+	for (int s = 0; s < searchStepCount; ++s) {
+		for (int d = 0; d < 4; ++d) {
+			const Point q{std::min(std::max(from.x + dirs[d][0] * searchSteps[s], 0), original.width() - 1),
+			              std::min(std::max(from.y + dirs[d][1] * searchSteps[s], 0), original.height() - 1)};
+			if (q.x == from.x && q.y == from.y)
+				continue;
+			candidate.set(v, q);
+			const float score = coveredSum(candidate, region, prefix);
+			if (!found || score < best) {
+				found = true;
+				best = score;
+				to = q;
+			}
+		}
+	}
+	return 3 * static_cast<std::size_t>((bg.iHi - bg.iLo + 1) * (bg.jHi - bg.jLo + 1));
+}
+
+
+// sum of per-pixel values (row prefix sums over region) covered by p
+template <class Pixel>
+float basic_img_iter<Pixel>::coveredSum(const Polygon& p, const Rectangle& region, const std::vector<float>& prefix) {
+	const int stride = region.x1 - region.x0 + 2;
+	float sum = 0;
+	const auto& lines = p.fillDetails();
+	for (auto it = lines.cbegin(); it != lines.cend(); ++it) {
+		assert((*it).y >= region.y0 && (*it).y <= region.y1);
+		const float* row = &prefix[((*it).y - region.y0) * stride];
+		for (std::size_t s = 0; s + 1 < (*it).xList.size(); s += 2) {
+			assert((*it).xList[s] >= region.x0 && (*it).xList[s + 1] <= region.x1);
+			sum += row[(*it).xList[s + 1] - region.x0 + 1] - row[(*it).xList[s] - region.x0];
+		}
+	}
+	return sum;
+}
+
+
+// canvas pixels covered by p, in fill order
+template <class Pixel>
+void basic_img_iter<Pixel>::readCoverage(const Polygon& p, std::vector<Color>& out) const {
+	out.clear();
+	const auto& lines = p.fillDetails();
+	for (auto it = lines.cbegin(); it != lines.cend(); ++it) {
+		for (std::size_t s = 0; s + 1 < (*it).xList.size(); s += 2) {
+			for (int x = (*it).xList[s]; x <= (*it).xList[s + 1]; ++x)
+				out.push_back(Color(canvas.get(x, (*it).y)));
+		}
 	}
 }
 
 
-float img_iter::getMaxAccuracy(const Image& img) {
-	return img.width() * img.height();
+// draw blocks changed[begin, end) and store their accuracy in acc (blocks are
+// independent, so they are spread across the scheduler)
+template <class Pixel>
+void basic_img_iter<Pixel>::drawAndScore(const std::vector<Index2D>& changed, const int begin, const int end, std::vector<float>& acc) {
+	auto work = [this, &changed, &acc] (const int k) {
+		drawBlock(changed[k].first, changed[k].second);
+		acc[k] = blockAccuracy(changed[k].first, changed[k].second);
+	};
+	scheduler.parallelFor(begin, end, 1, work);
 }
 
 
-// returns [0, 1], 1 being equal
-float img_iter::getAccuracy(const Color& c1, const Color& c2) {
-	return 1.0f - static_cast<float>(getDiff(c1.R, c2.R) + getDiff(c1.G, c2.G) + getDiff(c1.B, c1.B)) / (255 * 3);
+// Draw and score changed blocks, returns true if the candidate is an improvement
+// (drawn is set to the number of blocks drawn).
+// Blocks are scored largest headroom first, one wave of threadCount() blocks at
+// a time, and scoring stops once the gain so far plus the headroom of the
+// remaining blocks cannot be positive (later blocks are never redrawn).
+template <class Pixel>
+bool basic_img_iter<Pixel>::evaluate(std::vector<Index2D>& changed, std::vector<float>& acc, int& drawn) {
+	std::sort(changed.begin(), changed.end(), [this] (const Index2D& a, const Index2D& b) {
+		return headroom(a) > headroom(b);
+	});
+	float remaining = 0;	// max possible gain of unscored blocks
+	for (auto it = changed.cbegin(); it != changed.cend(); ++it)
+		remaining += headroom(*it);
+
+	acc.resize(changed.size());
+	const int n = static_cast<int>(changed.size());
+	const int wave = scheduler.threadCount();
+	float gain = 0;
+	for (int k = 0; k < n; k += wave) {
+		const int end = std::min(k + wave, n);
+		drawAndScore(changed, k, end, acc);
+		drawn = end;
+		for (int q = k; q < end; ++q) {
+			gain += acc[q] - blocks[changed[q].first][changed[q].second].acc;
+			remaining -= headroom(changed[q]);
+		}
+		if (end < n && gain + remaining <= 0)
+			return false;
+	}
+	return gain > 0;
 }
 
 
-int img_iter::getDiff(const Color::ColorChannel a, const Color::ColorChannel b) {
-	return std::abs(static_cast<int>(a) - static_cast<int>(b));
+// when guided, usually a polygon overlapping a block chosen by error
+template <class Pixel>
+std::size_t basic_img_iter<Pixel>::randPolyIndex() {
+	const int k = pm.randBlock();
+	if (k >= 0) {
+		const auto& set = blocks[errors.blockI(k)][errors.blockJ(k)].polygons;
+		if (!set.empty()) {
+			auto it = set.cbegin();
+			std::advance(it, pm.randIndex(set.size()));
+			return *it;
+		}
+	}
+	return pm.randPolyIndex(polygons.size());
 }
 
 
-float img_iter::getFitness() const {
+template <class Pixel>
+float basic_img_iter<Pixel>::headroom(const Index2D& index) const {
+	const Block& b = blocks[index.first][index.second];
+	return b.maxAcc - b.acc;
+}
+
+
+// mutations are sampled by block error when guided or weighted
+template <class Pixel>
+bool basic_img_iter<Pixel>::sampled() const {
+	return guided || weights != nullptr;
+}
+
+
+// true if sampled rows of changed blocks show the candidate is clearly worse
+template <class Pixel>
+bool basic_img_iter<Pixel>::prescreenReject(const std::vector<Index2D>& changed) {
+	std::vector<float> oldAcc(changed.size());
+	std::vector<float> newAcc(changed.size());
+	std::vector<int> samples(changed.size());
+	auto work = [this, &changed, &oldAcc, &newAcc, &samples] (const int k) {
+		sampleAccuracy(changed[k].first, changed[k].second, oldAcc[k], newAcc[k], samples[k]);
+	};
+	scheduler.parallelFor(0, static_cast<int>(changed.size()), 1, work);
+
+	float oldSum = 0;
+	float newSum = 0;
+	int n = 0;
+	for (std::size_t k = 0; k < changed.size(); ++k) {
+		oldSum += oldAcc[k];
+		newSum += newAcc[k];
+		n += samples[k];
+	}
+	return (n > 0) && (newSum < oldSum - prescreenMargin * n);
+}
+
+
+// draw sampled rows of block (i, j) and score them for the incumbent (best)
+// and the candidate (canvas)
+template <class Pixel>
+void basic_img_iter<Pixel>::sampleAccuracy(const int i, const int j, float& oldAcc, float& newAcc, int& n) {
+	oldAcc = 0;
+	newAcc = 0;
+	n = 0;
+	const auto& block = blocks[i][j];
+	Rectangle row;
+	row.x0 = i * blockSize;
+	row.x1 = std::min(row.x0 + blockSize - 1, original.width() - 1);
+	const int w = row.x1 - row.x0 + 1;
+	const int yLim = std::min((j + 1) * blockSize, original.height());
+	const int y0 = j * blockSize;
+	Rectangle mask;
+	mask.x0 = row.x0;
+	mask.x1 = row.x1;
+	mask.y0 = y0;
+	mask.y1 = yLim - 1;
+	PixelCanvas window{canvas.tile(i, j), blockSize, mask};
+	const Pixel* target = static_cast<const PixelTiles&>(original).tile(i, j);
+	const Pixel* incumbent = static_cast<const PixelTiles&>(best).tile(i, j);
+	const Pixel* drawn = window.row(0);
+	// sampled rows satisfy y % stride == stride / 2
+	for (int y = y0 + (prescreenStride / 2 - y0 % prescreenStride + prescreenStride) % prescreenStride; y < yLim; y += prescreenStride) {
+		row.y0 = y;
+		row.y1 = y;
+		window.fill(row, background, 1.0);
+		for (auto it = block.polygons.cbegin(); it != block.polygons.cend(); ++it) {
+			const auto& ip = polygons[*it];
+			const Rectangle bounds{ip.getBounds()};
+			if (y >= bounds.y0 && y <= bounds.y1)
+				window.fill(ip.getPolygon(), row, ip.getColor(), ip.getAlpha());
+		}
+		const int k = (y - y0) * blockSize;
+		oldAcc += rowAccuracy(target + k, incumbent + k, row.x0, y, w);
+		newAcc += rowAccuracy(target + k, drawn + k, row.x0, y, w);
+		n += w;
+	}
+}
+
+
+template <class Pixel>
+float basic_img_iter<Pixel>::getMaxAccuracy(const int w, const int h) {
+	return static_cast<float>(w) * h;
+}
+
+
+template <class Pixel>
+float basic_img_iter<Pixel>::getFitness() const {
 	float accuracy = 0;
 	for (int i = 0; i < blockCountX; ++i) {
 		for (int j = 0; j < blockCountY; ++j)
@@ -224,22 +952,50 @@ float img_iter::getFitness() const {
 }
 
 
-float img_iter::blockAccuracy(const int i, const int j) const {
+// accuracy of block (i, j) as drawn on canvas
+template <class Pixel>
+float basic_img_iter<Pixel>::blockAccuracy(const int i, const int j) const {
+	return blockAccuracy(i, j, canvas);
+}
+
+
+// accuracy of block (i, j) of img (canvas or best)
+template <class Pixel>
+float basic_img_iter<Pixel>::blockAccuracy(const int i, const int j, const PixelTiles& img) const {
 	float accuracy = 0;
-	const int xLim = std::min((i + 1) * blockSize, original.width());
+	const int x0 = i * blockSize;
+	const int w = std::min((i + 1) * blockSize, original.width()) - x0;
 	const int yLim = std::min((j + 1) * blockSize, original.height());
-	for (int x = i * blockSize; x < xLim; ++x) {
-		for (int y = j * blockSize; y < yLim; ++y)
-			accuracy += getAccuracy(original.get(x, y), canvas.getPoint(x, y));
-	}
+	const Pixel* target = original.tile(i, j);
+	const Pixel* drawn = img.tile(i, j);
+	for (int y = j * blockSize; y < yLim; ++y, target += blockSize, drawn += blockSize)
+		accuracy += rowAccuracy(target, drawn, x0, y, w);
 	return accuracy;
 }
 
 
-bool img_iter::sizeChange(const Mutation m) {
+// accuracy of n pixels of row y from x0, drawn over target, weighted if
+// weights are set
+template <class Pixel>
+float basic_img_iter<Pixel>::rowAccuracy(const Pixel* target, const Pixel* drawn, const int x0, const int y, const int n) const {
+	if (weights == nullptr)
+		return metric.accuracy(target, drawn, n);
+	return metric.accuracy(target, drawn, weights->row(y) + x0, n);
+}
+
+
+// mutations that can change a polygon's bounds
+template <class Pixel>
+bool basic_img_iter<Pixel>::sizeChange(const Mutation m) {
 	switch (m) {
 	case Mutation::X:
 	case Mutation::Y:
+	case Mutation::Vertex:
+	case Mutation::Translate:
+	case Mutation::Replace:
+	case Mutation::Search:
+	case Mutation::AddVert:
+	case Mutation::RemoveVert:
 		return true;
 	default:
 		return false;
@@ -247,7 +1003,8 @@ bool img_iter::sizeChange(const Mutation m) {
 }
 
 
-void img_iter::intersectIndex(const Rectangle& r, BlockGroup& b) const {
+template <class Pixel>
+void basic_img_iter<Pixel>::intersectIndex(const Rectangle& r, BlockGroup& b) const {
 	b.iLo = r.x0 / blockSize;
 	b.iHi = r.x1 / blockSize;
 	b.jLo = r.y0 / blockSize;
@@ -263,25 +1020,131 @@ void img_iter::intersectIndex(const Rectangle& r, BlockGroup& b) const {
 }
 
 
-// update which blocks reference this polygon
-void img_iter::updateBlockPolygon(const BlockGroup& bg, const IterPoly& ip, const bool add) {
-	const auto index = ip.getIndex();
-	if (add) {
-		for (int i = bg.iLo; i <= bg.iHi; ++i) {
-			for (int j = bg.jLo; j <= bg.jHi; ++j)
+// polygon index moved from blocks in 'from' to blocks in 'to', only blocks in
+// one group but not the other are updated
+template <class Pixel>
+void basic_img_iter<Pixel>::updateBlockPolygon(const int index, const BlockGroup& from, const BlockGroup& to) {
+	for (int i = from.iLo; i <= from.iHi; ++i) {
+		for (int j = from.jLo; j <= from.jHi; ++j) {
+			if (!contains(to, i, j))
+				blocks[i][j].polygons.erase(index);
+		}
+	}
+	for (int i = to.iLo; i <= to.iHi; ++i) {
+		for (int j = to.jLo; j <= to.jHi; ++j) {
+			if (!contains(from, i, j))
 				blocks[i][j].polygons.emplace(index);
 		}
 	}
-	else {
+}
+
+
+template <class Pixel>
+bool basic_img_iter<Pixel>::contains(const BlockGroup& bg, const int i, const int j) {
+	return (i >= bg.iLo) && (i <= bg.iHi) && (j >= bg.jLo) && (j <= bg.jHi);
+}
+
+
+// polygon next to ip in z-order within one of its blocks (ip itself if it is
+// alone there)
+template <class Pixel>
+IterPoly& basic_img_iter<Pixel>::swapPartner(const IterPoly& ip, const BlockGroup& bg) {
+	const int i = bg.iLo + static_cast<int>(pm.randIndex(bg.iHi - bg.iLo + 1));
+	const int j = bg.jLo + static_cast<int>(pm.randIndex(bg.jHi - bg.jLo + 1));
+	const auto& set = blocks[i][j].polygons;
+	auto it = set.find(ip.getIndex());
+	assert(it != set.cend());
+	const bool above = pm.randIndex(2) == 1;
+	if (above || it == set.cbegin()) {
+		++it;
+		if (it != set.cend())
+			return polygons[*it];
+		--it;
+	}
+	if (it != set.cbegin())
+		return polygons[*(--it)];
+	return polygons[ip.getIndex()];
+}
+
+
+// Blocks whose drawing changes when polygons at indices a and b (covering bga,
+// bgb) swap places: blocks with both, or with one of them and a polygon
+// between them in z-order.
+template <class Pixel>
+void basic_img_iter<Pixel>::addSwapBlocks(std::set<Index2D>& s, const int a, const int b, const BlockGroup& bga, const BlockGroup& bgb) const {
+	if (a == b)
+		return;
+	const int lo = std::min(a, b);
+	const int hi = std::max(a, b);
+	auto check = [this, &s, lo, hi] (const BlockGroup& bg) {
 		for (int i = bg.iLo; i <= bg.iHi; ++i) {
-			for (int j = bg.jLo; j <= bg.jHi; ++j)
+			for (int j = bg.jLo; j <= bg.jHi; ++j) {
+				const auto& set = blocks[i][j].polygons;
+				const auto it = set.upper_bound(lo);
+				const bool both = set.count(lo) != 0 && set.count(hi) != 0;
+				if (both || (it != set.cend() && *it < hi))
+					s.emplace(i, j);
+			}
+		}
+	};
+	check(bga);
+	check(bgb);
+}
+
+
+// new polygon on top of the others
+template <class Pixel>
+void basic_img_iter<Pixel>::addPolygon() {
+	const Polygon p{pm.randSimplePoly()};
+	const Rectangle r{p.getBounds()};
+	const Color c{original.get((r.x0 + r.x1) / 2, (r.y0 + r.y1) / 2)};
+	polygons.emplace_back(pm, p, c, pm.randAlpha());
+	polygons.back().setIndex(polygons.size() - 1);
+	BlockGroup bg;
+	intersectIndex(r, bg);
+	indexPolygon(polygons.back().getIndex(), bg, true);
+}
+
+
+// erase polygon index, polygons above it move down one index (their order and
+// so the drawing is unchanged)
+template <class Pixel>
+void basic_img_iter<Pixel>::removePolygon(const int index) {
+	polygons.erase(polygons.begin() + index);
+	for (std::size_t i = index; i < polygons.size(); ++i)
+		polygons[i].setIndex(i);
+	for (int i = 0; i < blockCountX; ++i) {
+		for (int j = 0; j < blockCountY; ++j) {
+			std::set<int>& set = blocks[i][j].polygons;
+			if (set.lower_bound(index) == set.cend())
+				continue;
+			std::set<int> renumbered;
+			for (auto it = set.cbegin(); it != set.cend(); ++it) {
+				if (*it != index)
+					renumbered.emplace_hint(renumbered.cend(), *it > index ? *it - 1 : *it);
+			}
+			set.swap(renumbered);
+		}
+	}
+}
+
+
+// add or remove polygon index in blocks of bg
+template <class Pixel>
+void basic_img_iter<Pixel>::indexPolygon(const int index, const BlockGroup& bg, const bool add) {
+	for (int i = bg.iLo; i <= bg.iHi; ++i) {
+		for (int j = bg.jLo; j <= bg.jHi; ++j) {
+			if (add)
+				blocks[i][j].polygons.emplace(index);
+			else
 				blocks[i][j].polygons.erase(index);
 		}
 	}
 }
 
 
-void img_iter::addBlockSet(std::set<Index2D>& s, const BlockGroup& bg) {
+template <class Pixel>
+void basic_img_iter<Pixel>::addBlockSet(std::set<Index2D>& s, const BlockGroup& bg) {
 	for (int i = bg.iLo; i <= bg.iHi; ++i) {
 		for (int j = bg.jLo; j <= bg.jHi; ++j)
 			s.emplace(i, j);
@@ -289,18 +1152,81 @@ void img_iter::addBlockSet(std::set<Index2D>& s, const BlockGroup& bg) {
 }
 
 
+// the polygons at their indices after accepted mutation m
+template <class Pixel>
+void basic_img_iter<Pixel>::journalMutation(const Mutation m, const IterPoly& ip, const IterPoly* other) {
+	if (m == Mutation::Swap)
+		journal->mutation(imp, m, ip.getIndex(), other->getIndex());
+	else if (m == Mutation::Remove)
+		journal->mutation(imp, m, ip.getIndex(), 0);
+	else
+		journal->mutation(imp, m, ip.getIndex(), ip.getPolygon(), ip.getColor(), ip.getAlpha());
+}
+
+
 // copy block from canvas to best
-void img_iter::copyBlock(Image& img, const Canvas& can, const Index2D& index) {
+template <class Pixel>
+void basic_img_iter<Pixel>::copyBlock(const Index2D& index) {
+	const Pixel* src = static_cast<const PixelTiles&>(canvas).tile(index.first, index.second);
+	std::copy(src, src + blockSize * blockSize, best.tile(index.first, index.second));
+}
+
+
+// calls f(i, j) for every block, spread across the scheduler. When tiled,
+// one column of blocks at a time, trimming the tiles in between.
+template <class Pixel>
+template <class F>
+void basic_img_iter<Pixel>::forEachBlock(F& f) {
+	if (!tiledMode) {
+		auto work = [this, &f] (const int k) {
+			f(k / blockCountY, k % blockCountY);
+		};
+		scheduler.parallelFor(0, blockCountX * blockCountY, blockCountY, work);
+		return;
+	}
+	for (int i = 0; i < blockCountX; ++i) {
+		auto work = [i, &f] (const int j) {
+			f(i, j);
+		};
+		scheduler.parallelFor(0, blockCountY, 1, work);
+		trimTiles();
+	}
+}
+
+
+// evicts tiles over budget (no tile may be in use)
+template <class Pixel>
+void basic_img_iter<Pixel>::trimTiles() {
+	original.trim();
+	best.trim();
+	canvas.trim();
+}
+
+
+// copy best to view, once bestImage() was called
+template <class Pixel>
+void basic_img_iter<Pixel>::updateView() const {
+	if (viewed)
+		view = Image{best.getImage()};
+}
+
+
+// copy block of best to view
+template <class Pixel>
+void basic_img_iter<Pixel>::updateView(const Index2D& index) const {
+	if (!viewed)
+		return;
 	const int xLim = std::min((index.first + 1) * blockSize, original.width());
 	const int yLim = std::min((index.second + 1) * blockSize, original.height());
 	for (int x = index.first * blockSize; x < xLim; ++x) {
 		for (int y = index.second * blockSize; y < yLim; ++y)
-			img.set(x, y, can.getPoint(x, y));
+			view.set(x, y, Color(best.get(x, y)));
 	}
 }
 
 
-bool img_iter::validBlocks(void) const {
+template <class Pixel>
+bool basic_img_iter<Pixel>::validBlocks(void) const {
 	BlockGroup bg;
 	for (auto it = polygons.cbegin(); it != polygons.cend(); ++it) {
 		const auto index = (*it).getIndex();
@@ -313,5 +1239,215 @@ bool img_iter::validBlocks(void) const {
 			}
 		}
 	}
+	// no stale entries
+	for (int i = 0; i < blockCountX; ++i) {
+		for (int j = 0; j < blockCountY; ++j) {
+			for (auto it = blocks[i][j].polygons.cbegin(); it != blocks[i][j].polygons.cend(); ++it) {
+				intersectIndex(polygons[*it].getBounds(), bg);
+				if (!contains(bg, i, j))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+// Streams rows into a tile file next to path and evolves d (random polygons
+// if empty) with at most budget bytes of tiles resident after each iteration.
+// The tile file is removed once mapped, best spills to <path>.best.tiles.
+template <class Pixel>
+img_iter* basic_img_iter<Pixel>::createTiled(const FileHelper::PPMRows& rows, const std::string& path, const std::size_t budget,
+                                             const DNA& d, const int pc, const int vc, TaskScheduler& ts, const std::uint64_t seed, std::string& error) {
+	const std::string tilePath = path + ".tiles";
+	const std::string spillPath = path + ".best.tiles";
+	if (!PixelTiles::build(tilePath, rows, blockSize)) {
+		error = "can't write " + tilePath;
+		return nullptr;
+	}
+	const bool random = d.data.empty();
+	basic_img_iter* ii = new basic_img_iter(rows.width(), rows.height(), random ? pc : d.polyCount,
+	                                        random ? vc : (d.vertCount > 0 ? d.vertCount : d.data.front().v.size()), ts, seed);
+	const bool mapped = ii->original.map(tilePath);
+	std::remove(tilePath.c_str());	// the mapping stays valid
+	if (!mapped || !ii->best.spill(spillPath)) {
+		delete ii;
+		error = "can't use tile files " + tilePath + ", " + spillPath;
+		return nullptr;
+	}
+	ii->original.setBudget(budget / 3);
+	ii->best.setBudget(budget / 3);
+	ii->canvas.setBudget(budget / 3);
+	ii->tiledMode = true;
+	if (random) {
+		for (int i = 0; i < pc; ++i) {
+			ii->polygons.emplace_back(ii->pm);
+			ii->polygons.back().setIndex(i);
+		}
+	}
+	else {
+		int i = 0;
+		for (auto it = d.data.begin(); it != d.data.end(); ++it, ++i) {
+			ii->polygons.emplace_back(ii->pm, *it);
+			ii->polygons.back().setIndex(i);
+		}
+	}
+	ii->init();
+	return ii;
+}
+
+
+template class basic_img_iter<Color>;
+template class basic_img_iter<Gray8>;
+
+
+template <class Pixel>
+BasicImageSnapshot<Pixel>::BasicImageSnapshot(const TiledImage<Pixel>& img, const std::shared_ptr<const PixelImage>& w)
+: WIDTH(img.width()), HEIGHT(img.height()), size(img.tileSize()),
+  countX((WIDTH + size - 1) / size), tiles(img.share()), weights(w) {
+}
+
+
+template <class Pixel>
+int BasicImageSnapshot<Pixel>::width() const {
+	return WIDTH;
+}
+
+
+template <class Pixel>
+int BasicImageSnapshot<Pixel>::height() const {
+	return HEIGHT;
+}
+
+
+// row y as Color into dst (width() pixels)
+template <class Pixel>
+void BasicImageSnapshot<Pixel>::row(const int y, Color* dst) const {
+	for (int i = 0; i < countX; ++i) {
+		const Pixel* src = rowPart(i, y);
+		const int n = std::min(size, WIDTH - i * size);
+		for (int x = 0; x < n; ++x)
+			dst[i * size + x] = Color(src[x]);
+	}
+}
+
+
+// the best image and weights sections of a checkpoint (see basic_img_iter::checkpoint)
+template <class Pixel>
+void BasicImageSnapshot<Pixel>::checkpoint(CheckpointWriter& w) const {
+	for (int y = 0; y < HEIGHT; ++y) {
+		for (int i = 0; i < countX; ++i)
+			w.putBytes(rowPart(i, y), std::min(size, WIDTH - i * size) * sizeof(Pixel));
+	}
+	w.put8(weights != nullptr);
+	if (weights != nullptr) {
+		for (int y = 0; y < weights->height(); ++y)
+			w.putBytes(weights->row(y), weights->width() * sizeof(Pixel));
+	}
+}
+
+
+// row y of tile column i
+template <class Pixel>
+const Pixel* BasicImageSnapshot<Pixel>::rowPart(const int i, const int y) const {
+	return tiles[(y / size) * countX + i].get() + (y % size) * size;
+}
+
+
+template class BasicImageSnapshot<Color>;
+template class BasicImageSnapshot<Gray8>;
+
+
+img_iter* img_iter::create(const Image& img, const int pc, const int vc, TaskScheduler& ts, const std::uint64_t seed) {
+	if (monochrome(img))
+		return new basic_img_iter<Gray8>(img, pc, vc, ts, seed);
+	return new basic_img_iter<Color>(img, pc, vc, ts, seed);
+}
+
+
+img_iter* img_iter::create(const Image& img, const DNA& d, TaskScheduler& ts, const std::uint64_t seed) {
+	if (monochrome(img))
+		return new basic_img_iter<Gray8>(img, d, ts, seed);
+	return new basic_img_iter<Color>(img, d, ts, seed);
+}
+
+
+// see basic_img_iter::createTiled()
+img_iter* img_iter::createTiled(const FileHelper::PPMRows& rows, const std::string& path, const std::size_t budget,
+                                const DNA& d, const int pc, const int vc, TaskScheduler& ts, const std::uint64_t seed, std::string& error) {
+	if (monochrome(rows))
+		return basic_img_iter<Gray8>::createTiled(rows, path, budget, d, pc, vc, ts, seed, error);
+	return basic_img_iter<Color>::createTiled(rows, path, budget, d, pc, vc, ts, seed, error);
+}
+
+
+// Continues the run saved by checkpoint() at path. img must be the image the
+// run was started with; returns nullptr and sets error otherwise.
+img_iter* img_iter::resume(const Image& img, const std::string& path, TaskScheduler& ts, std::string& error) {
+	CheckpointReader r;
+	if (!r.open(path, error))
+		return nullptr;
+	const bool gray = r.get8() != 0;
+	const int w = r.get32();
+	const int h = r.get32();
+	const int vc = r.get32();
+	const int pc = r.get32();
+	if (!r.good() || vc < 3 || pc < 1) {
+		error = "invalid checkpoint";
+		return nullptr;
+	}
+	if (w != img.width() || h != img.height()) {
+		error = "checkpoint is for a " + patch::to_string(w) + "x" + patch::to_string(h) + " image";
+		return nullptr;
+	}
+	if (gray && !monochrome(img)) {
+		error = "checkpoint is for a gray image";
+		return nullptr;
+	}
+	img_iter* ii;
+	bool loaded;
+	if (gray) {
+		basic_img_iter<Gray8>* g = new basic_img_iter<Gray8>(img, pc, vc, ts, 0, true);
+		loaded = g->load(r, pc);
+		ii = g;
+	}
+	else {
+		basic_img_iter<Color>* c = new basic_img_iter<Color>(img, pc, vc, ts, 0, true);
+		loaded = c->load(r, pc);
+		ii = c;
+	}
+	if (!loaded) {
+		delete ii;
+		error = "invalid checkpoint";
+		return nullptr;
+	}
+	return ii;
+}
+
+
+// true if every pixel is gray (R = G = B)
+bool img_iter::monochrome(const Image& img) {
+	for (int y = 0; y < img.height(); ++y) {
+		const Color* row = img.row(y);
+		for (int x = 0; x < img.width(); ++x) {
+			if (row[x].R != row[x].G || row[x].R != row[x].B)
+				return false;
+		}
+	}
+	return true;
+}
+
+
+// like monochrome(const Image&), one row at a time
+bool img_iter::monochrome(const FileHelper::PPMRows& rows) {
+	std::vector<Color> row(rows.width());
+	for (int y = 0; y < rows.height(); ++y) {
+		rows.read(y, row.data());
+		for (int x = 0; x < rows.width(); ++x) {
+			if (row[x].R != row[x].G || row[x].R != row[x].B)
+				return false;
+		}
+		rows.release(y);
+	}
 	return true;
 }
@@ -1,64 +1,201 @@
 #pragma once
 
 #include "canvas.h"
+#include "checkpoint.h"
+#include "color_fit.h"
 #include "dna.h"
+#include "error_sampler.h"
+#include "journal.h"
+#include "metric.h"
 #include "poly_mutator.h"
+#include "task_scheduler.h"
+#include "tiled_image.h"
 #include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <memory>
 #include <set>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 
+// counters for the optional subsampled pre-screen
+struct PrescreenStats {
+	unsigned int checks = 0;	// candidates pre-screened
+	unsigned int rejects = 0;	// rejected by pre-screen
+	unsigned int audits = 0;	// rejections evaluated exactly anyway
+	unsigned int wrong = 0;		// audited rejections that were improvements
+	unsigned int passedWorse = 0;	// passed pre-screen but rejected exactly
+};
+
+
+// Best image (and weights) of an img_iter when snapshot() was called. Taking
+// one shares the tiles instead of copying them, it may then be read on any
+// thread and outlive the img_iter.
+class ImageSnapshot {
+public:
+	virtual ~ImageSnapshot() = default;
+	virtual int width(void) const = 0;
+	virtual int height(void) const = 0;
+	virtual void row(const int, Color*) const = 0;
+	virtual void checkpoint(CheckpointWriter&) const = 0;
+};
+
+
+// Evolves polygons toward an image. create() picks the pixel type the image
+// is scored in: Gray8 when every pixel is gray, which draws and compares one
+// channel instead of three. checkpoint() and the snapshot() taken with it
+// save the complete state, resume() continues it exactly as if the run had
+// not stopped.
+// The images are held as tiles of one block. createTiled() streams a ppm into
+// a tile file and keeps resident tiles within a memory budget, for images too
+// large to hold (no weights, checkpoints or bestImage() then).
 class img_iter {
+public:
+	static img_iter* create(const Image&, const int, const int, TaskScheduler&, const std::uint64_t);
+	static img_iter* create(const Image&, const DNA&, TaskScheduler&, const std::uint64_t);
+	static img_iter* createTiled(const FileHelper::PPMRows&, const std::string&, const std::size_t,
+	                             const DNA&, const int, const int, TaskScheduler&, const std::uint64_t, std::string&);
+	static img_iter* resume(const Image&, const std::string&, TaskScheduler&, std::string&);
+	static bool monochrome(const Image&);
+	static bool monochrome(const FileHelper::PPMRows&);
+	virtual ~img_iter() = default;
+	virtual void iterate(void) = 0;
+	virtual void improve(void) = 0;
+	virtual int iterations(void) const = 0;
+	virtual int improvements(void) const = 0;
+	virtual float fitness(void) const = 0;
+	virtual int runtime(void) const = 0;
+	virtual Image getImage(void) const = 0;
+	virtual const Image& bestImage(void) const = 0;
+	virtual DNA getDNA(void) const = 0;
+	virtual void setPrescreen(const int, const float) = 0;
+	virtual const PrescreenStats& prescreenStats(void) const = 0;
+	virtual void setGuided(const bool) = 0;
+	virtual void setAdaptive(const bool) = 0;
+	virtual const OperatorSelector& operatorStats(void) const = 0;
+	virtual void setGrowth(const int, const int) = 0;
+	virtual void setMetric(const Metric) = 0;
+	virtual bool setWeights(const Image&) = 0;
+	virtual void setJournal(Journal*) = 0;
+	virtual int polygonCount(void) const = 0;
+	virtual void checkpoint(CheckpointWriter&) const = 0;
+	virtual ImageSnapshot* snapshot(void) const = 0;
+	virtual bool tiled(void) const = 0;
+};
+
+
+// img_iter scoring in Pixel (Color or Gray8), instantiated in img_iter.cpp
+template <class Pixel>
+class basic_img_iter : public img_iter {
+	typedef BasicImage<Pixel> PixelImage;
+	typedef BasicCanvas<Pixel> PixelCanvas;
+	typedef TiledImage<Pixel> PixelTiles;
 	struct BlockGroup {
 		int iLo, iHi, jLo, jHi;	// indices (INCLUSIVE)
 	};
 	struct Block {
 		float acc = 0;
+		float maxAcc = 0;	// accuracy if block matched exactly
 		std::set<int> polygons;
 	};
 	typedef std::pair<int, int> Index2D;
 public:
-	img_iter(const Image&, const int, const int);
-	img_iter(const Image&, const DNA&);
-	~img_iter() = default;
-	void iterate(void);
-	void improve(void);
-	int iterations(void) const;
-	int improvements(void) const;
-	float fitness(void) const;
-	int runtime(void) const;
-	Image getImage(void) const;
-	const Image& bestImage(void) const;
-	DNA getDNA(void) const;
+	basic_img_iter(const Image&, const int, const int, TaskScheduler&, const std::uint64_t);
+	basic_img_iter(const Image&, const DNA&, TaskScheduler&, const std::uint64_t);
+	~basic_img_iter() = default;
+	void iterate(void) override;
+	void improve(void) override;
+	int iterations(void) const override;
+	int improvements(void) const override;
+	float fitness(void) const override;
+	int runtime(void) const override;
+	Image getImage(void) const override;
+	const Image& bestImage(void) const override;
+	DNA getDNA(void) const override;
+	void setPrescreen(const int, const float) override;
+	const PrescreenStats& prescreenStats(void) const override;
+	void setGuided(const bool) override;
+	void setAdaptive(const bool) override;
+	const OperatorSelector& operatorStats(void) const override;
+	void setGrowth(const int, const int) override;
+	void setMetric(const Metric) override;
+	bool setWeights(const Image&) override;
+	void setJournal(Journal*) override;
+	int polygonCount(void) const override;
+	void checkpoint(CheckpointWriter&) const override;
+	ImageSnapshot* snapshot(void) const override;
+	bool tiled(void) const override;
 private:
-	img_iter(const Image&, const int, const int, bool);
+	basic_img_iter(const int, const int, const int, const int, TaskScheduler&, const std::uint64_t);
+	basic_img_iter(const Image&, const int, const int, TaskScheduler&, const std::uint64_t, bool);
+	static img_iter* createTiled(const FileHelper::PPMRows&, const std::string&, const std::size_t,
+	                             const DNA&, const int, const int, TaskScheduler&, const std::uint64_t, std::string&);
 	void init();
+	bool load(CheckpointReader&, const std::size_t);
 	void drawPolygons(void);
 	void drawBlock(const int, const int);
-	static float getMaxAccuracy(const Image&);
-	static float getAccuracy(const Color&, const Color&);
-	static int getDiff(const Color::ColorChannel, const Color::ColorChannel);
+	void drawBlock(const int, const int, const int, const Color&, const float);
+	void fitColor(const IterPoly&, const BlockGroup&, Color&, float&);
+	void drawGroup(const BlockGroup&, const int, const Color&, const float);
+	void readCoverage(const Polygon&, std::vector<Color>&) const;
+	void readRect(const Rectangle&, std::vector<Color>&) const;
+	std::size_t searchVertex(const IterPoly&, std::size_t&, Point&);
+	static float coveredSum(const Polygon&, const Rectangle&, const std::vector<float>&);
+	static float getMaxAccuracy(const int, const int);
 	float getFitness(void) const;
 	float blockAccuracy(const int, const int) const;
+	float blockAccuracy(const int, const int, const PixelTiles&) const;
+	float rowAccuracy(const Pixel*, const Pixel*, const int, const int, const int) const;
+	void rescore(void);
 	static bool sizeChange(const Mutation);
 	void intersectIndex(const Rectangle&, BlockGroup&) const;
-	void updateBlockPolygon(const BlockGroup&, const IterPoly&, const bool);
+	void updateBlockPolygon(const int, const BlockGroup&, const BlockGroup&);
+	static bool contains(const BlockGroup&, const int, const int);
+	IterPoly& swapPartner(const IterPoly&, const BlockGroup&);
+	void addPolygon(void);
+	void removePolygon(const int);
+	void indexPolygon(const int, const BlockGroup&, const bool);
 	static void addBlockSet(std::set<Index2D>&, const BlockGroup&);
-	void copyBlock(Image&, const Canvas&, const Index2D&);
+	void addSwapBlocks(std::set<Index2D>&, const int, const int, const BlockGroup&, const BlockGroup&) const;
+	void drawAndScore(const std::vector<Index2D>&, const int, const int, std::vector<float>&);
+	bool evaluate(std::vector<Index2D>&, std::vector<float>&, int&);
+	float headroom(const Index2D&) const;
+	bool sampled(void) const;
+	std::size_t randPolyIndex(void);
+	bool prescreenReject(const std::vector<Index2D>&);
+	void sampleAccuracy(const int, const int, float&, float&, int&);
+	void copyBlock(const Index2D&);
+	void journalMutation(const Mutation, const IterPoly&, const IterPoly*);
+	template <class F> void forEachBlock(F&);
+	void trimTiles(void);
+	void updateView(void) const;
+	void updateView(const Index2D&) const;
 	bool validBlocks(void) const;
 
+	friend class img_iter;
 	static constexpr int blockSize = 50;	// px
-	static constexpr float maxBlockAccuracy = blockSize * blockSize;
+	static constexpr unsigned int auditInterval = 16;	// audit every nth pre-screen rejection
+	static constexpr int fitAlphaCount = 7;
+	static constexpr float fitAlphas[fitAlphaCount] = {0.1f, 0.25f, 0.4f, 0.55f, 0.7f, 0.85f, 1.0f};	// tried by Fit besides the current alpha
+	static constexpr int searchStepCount = 4;
+	static constexpr int searchSteps[searchStepCount] = {1, 2, 4, 8};	// px, tried along each axis by Search
 	const Color background;
-	const Image original;
-	Image best;
-	Canvas canvas;
+	PixelTiles original;
+	PixelTiles best;
+	PixelTiles canvas;	// scratch, blocks are drawn before they are read
+	mutable Image view;	// best as Color, kept once bestImage() is called
+	mutable bool viewed = false;
+	bool tiledMode = false;	// tiles are budgeted
 	poly_mutator pm;
-	const float maxAccuracy;
+	TaskScheduler& scheduler;
+	float maxAccuracy;
+	FitnessMetric metric{Metric::SAD};
+	std::shared_ptr<const PixelImage> weights;	// gray (R = G = B) pixel weights, null if unweighted
 	std::vector<IterPoly> polygons;
 	std::vector<std::vector<Block>> blocks;
 	const int blockCountX;
@@ -66,5 +203,36 @@ private:
 	unsigned int iter = 0;
 	unsigned int imp = 0;
 	float fit = 0;
+	int prescreenStride = 0;	// 0 disables pre-screen
+	float prescreenMargin = 0;	// accuracy per sampled pixel
+	PrescreenStats ps;
+	ErrorSampler errors;
+	bool guided = false;	// sampling by error is also on while weighted (see sampled())
+	int maxPolygons = 0;	// 0 keeps polygon count fixed
+	int maxVertices = 0;	// 0 keeps vertex counts fixed
+	ColorFit colorFit;
+	Journal* journal = nullptr;	// accepted mutations are recorded if set
 	std::chrono::high_resolution_clock::time_point start;
 };
+
+
+// ImageSnapshot of a basic_img_iter<Pixel>
+template <class Pixel>
+class BasicImageSnapshot : public ImageSnapshot {
+	typedef BasicImage<Pixel> PixelImage;
+public:
+	BasicImageSnapshot(const TiledImage<Pixel>&, const std::shared_ptr<const PixelImage>&);
+	int width(void) const override;
+	int height(void) const override;
+	void row(const int, Color*) const override;
+	void checkpoint(CheckpointWriter&) const override;
+private:
+	const Pixel* rowPart(const int, const int) const;
+
+	const int WIDTH;
+	const int HEIGHT;
+	const int size;	// px per tile side
+	const int countX;
+	const std::vector<std::shared_ptr<const Pixel>> tiles;
+	const std::shared_ptr<const PixelImage> weights;	// null if unweighted
+};
@@ -0,0 +1,332 @@
+#include "initializer.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+
+std::string InitStrategyToString(const InitStrategy s) {
+	switch (s) {
+	case InitStrategy::RANDOM:
+		return "random";
+	case InitStrategy::SIMPLE:
+		return "simple";
+	case InitStrategy::QUADTREE:
+		return "quadtree";
+	case InitStrategy::KMEANS:
+		return "kmeans";
+	case InitStrategy::NONE:
+	default:
+		return std::string();
+	}
+}
+
+
+InitStrategy stringToInitStrategy(const std::string& s) {
+	if (s == "random")
+		return InitStrategy::RANDOM;
+	if (s == "simple")
+		return InitStrategy::SIMPLE;
+	if (s == "quadtree")
+		return InitStrategy::QUADTREE;
+	if (s == "kmeans")
+		return InitStrategy::KMEANS;
+	return InitStrategy::NONE;
+}
+
+
+// vc vertices per polygon, the seed is mixed so the sequence differs from an
+// img_iter with the same seed
+Initializer::Initializer(const Image& image, const int vc, const std::uint64_t seed)
+: img(image), vertCount(vc), pm(vc, image.width(), image.height(), seed ^ seedMix), rng(seed ^ seedMix, 1) {
+	buildTables();
+}
+
+
+DNA Initializer::make(const InitStrategy s, const int pc) {
+	switch (s) {
+	case InitStrategy::SIMPLE:
+		return simple(pc);
+	case InitStrategy::QUADTREE:
+		return quadtree(pc);
+	case InitStrategy::KMEANS:
+		return kmeans(pc);
+	case InitStrategy::RANDOM:
+	default:
+		return random(pc);
+	}
+}
+
+
+DNA Initializer::random(const int pc) {
+	DNA d(pc, vertCount);
+	for (int i = 0; i < pc; ++i) {
+		const Polygon p{pm.randPoly()};
+		const Color c{pm.randColor()};
+		d.add(p, c, pm.randAlpha());
+	}
+	return d;
+}
+
+
+// each polygon sits in a random rectangle about twice the side of an equal
+// share of the image, so together they cover it a few times over
+DNA Initializer::simple(const int pc) {
+	DNA d(pc, vertCount);
+	const int w = img.width();
+	const int h = img.height();
+	const int side = std::max(2, static_cast<int>(2 * std::sqrt(static_cast<double>(w) * h / pc)));
+	for (int i = 0; i < pc; ++i) {
+		const int cx = rng.bounded(w);
+		const int cy = rng.bounded(h);
+		Rectangle r;
+		r.x0 = std::max(cx - side / 2, 0);
+		r.y0 = std::max(cy - side / 2, 0);
+		r.x1 = std::min(cx + side / 2, w - 1);
+		r.y1 = std::min(cy + side / 2, h - 1);
+		const float spacing = rng.uniform();
+		const Polygon p{pm.randSimplePoly(r, spacing, rng.uniform())};
+		d.add(p, meanColor(p.getBounds()), 0.4f + 0.5f * rng.uniform());
+	}
+	return d;
+}
+
+
+// The whole image is the first polygon. The region with the largest squared
+// error against its mean color is split into quadrants until pc polygons
+// exist, children are drawn opaque above their parent.
+DNA Initializer::quadtree(const int pc) {
+	typedef std::pair<double, Rectangle> Region;
+	auto less = [] (const Region& a, const Region& b) {
+		return a.first < b.first;
+	};
+	std::priority_queue<Region, std::vector<Region>, decltype(less)> queue{less};
+	DNA d(pc, vertCount);
+	Rectangle all;
+	all.x0 = 0;
+	all.y0 = 0;
+	all.x1 = img.width() - 1;
+	all.y1 = img.height() - 1;
+	d.add(rectPoly(all), meanColor(all), 1.0f);
+	queue.emplace(error(all), all);
+	while (static_cast<int>(d.data.size()) < pc && !queue.empty()) {
+		const Rectangle r{queue.top().second};
+		queue.pop();
+		if (r.x1 == r.x0 && r.y1 == r.y0)
+			continue;
+		const int mx = (r.x0 + r.x1) / 2;
+		const int my = (r.y0 + r.y1) / 2;
+		Rectangle q[4];
+		int n = 0;
+		for (int i = 0; i < 2; ++i) {
+			for (int j = 0; j < 2; ++j) {
+				Rectangle c;
+				c.x0 = i == 0 ? r.x0 : mx + 1;
+				c.x1 = i == 0 ? mx : r.x1;
+				c.y0 = j == 0 ? r.y0 : my + 1;
+				c.y1 = j == 0 ? my : r.y1;
+				if (c.x0 <= c.x1 && c.y0 <= c.y1)
+					q[n++] = c;
+			}
+		}
+		for (int k = 0; k < n && static_cast<int>(d.data.size()) < pc; ++k) {
+			d.add(rectPoly(q[k]), meanColor(q[k]), 1.0f);
+			queue.emplace(error(q[k]), q[k]);
+		}
+	}
+	// image smaller than pc regions
+	while (static_cast<int>(d.data.size()) < pc)
+		d.add(rectPoly(all), meanColor(all), 0.0f);
+	d.polyCount = d.data.size();
+	return d;
+}
+
+
+// k-means over subsampled pixels in (x, y, R, G, B), with position scaled so a
+// grid cell's side weighs like the full color range (like SLIC superpixels).
+// Each cluster becomes an ellipse at two standard deviations of its pixels.
+DNA Initializer::kmeans(const int pc) {
+	const int w = img.width();
+	const int h = img.height();
+	const int step = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(w) * h / kmeansSamples)));
+	const double cell = std::sqrt(static_cast<double>(w) * h / pc);
+	const double scale = kmeansSpatial * 255.0 / cell;
+	std::vector<float> samples;	// 5 per pixel
+	for (int y = step / 2; y < h; y += step) {
+		for (int x = step / 2; x < w; x += step) {
+			const Color c{img.get(x, y)};
+			samples.push_back(x * scale);
+			samples.push_back(y * scale);
+			samples.push_back(c.R);
+			samples.push_back(c.G);
+			samples.push_back(c.B);
+		}
+	}
+	const std::size_t count = samples.size() / 5;
+
+	// centers start at random samples
+	std::vector<float> centers(5 * pc);
+	for (int k = 0; k < pc; ++k) {
+		const std::size_t s = rng.bounded(count);
+		std::copy(samples.begin() + 5 * s, samples.begin() + 5 * s + 5, centers.begin() + 5 * k);
+	}
+	std::vector<int> label(count, 0);
+	std::vector<Cluster> clusters(pc);
+	for (int round = 0; round <= kmeansRounds; ++round) {
+		for (std::size_t s = 0; s < count; ++s) {
+			const float* p = &samples[5 * s];
+			float best = 0;
+			for (int k = 0; k < pc; ++k) {
+				const float* c = &centers[5 * k];
+				float dist = 0;
+				for (int f = 0; f < 5; ++f)
+					dist += (p[f] - c[f]) * (p[f] - c[f]);
+				if (k == 0 || dist < best) {
+					best = dist;
+					label[s] = k;
+				}
+			}
+		}
+		std::fill(clusters.begin(), clusters.end(), Cluster{{0, 0, 0, 0, 0}, 0, 0, 0, 0});
+		for (std::size_t s = 0; s < count; ++s) {
+			Cluster& c = clusters[label[s]];
+			const float* p = &samples[5 * s];
+			for (int f = 0; f < 5; ++f)
+				c.sum[f] += p[f];
+			c.xx += static_cast<double>(p[0]) * p[0];
+			c.xy += static_cast<double>(p[0]) * p[1];
+			c.yy += static_cast<double>(p[1]) * p[1];
+			++c.n;
+		}
+		for (int k = 0; k < pc; ++k) {
+			if (clusters[k].n == 0)
+				continue;
+			for (int f = 0; f < 5; ++f)
+				centers[5 * k + f] = clusters[k].sum[f] / clusters[k].n;
+		}
+	}
+
+	// largest clusters first (lowest)
+	std::vector<int> order;
+	for (int k = 0; k < pc; ++k) {
+		if (clusters[k].n > 0)
+			order.push_back(k);
+	}
+	std::sort(order.begin(), order.end(), [&clusters] (const int a, const int b) {
+		return clusters[a].n > clusters[b].n;
+	});
+	DNA d(pc, vertCount);
+	for (auto it = order.cbegin(); it != order.cend(); ++it) {
+		const Cluster& c = clusters[*it];
+		const double mx = c.sum[0] / c.n;
+		const double my = c.sum[1] / c.n;
+		// covariance in pixels, at least the sample spacing
+		const double minVar = static_cast<double>(step) * step / 4;
+		const double vxx = std::max((c.xx / c.n - mx * mx) / (scale * scale), minVar);
+		const double vyy = std::max((c.yy / c.n - my * my) / (scale * scale), minVar);
+		const double vxy = (c.xy / c.n - mx * my) / (scale * scale);
+		const Color color{static_cast<Color::ColorChannel>(std::lround(c.sum[2] / c.n)),
+		                  static_cast<Color::ColorChannel>(std::lround(c.sum[3] / c.n)),
+		                  static_cast<Color::ColorChannel>(std::lround(c.sum[4] / c.n))};
+		d.add(ellipsePoly(mx / scale, my / scale, vxx, vxy, vyy), color, clusterAlpha);
+	}
+	// empty clusters
+	while (static_cast<int>(d.data.size()) < pc) {
+		const Polygon p{pm.randSimplePoly()};
+		d.add(p, meanColor(p.getBounds()), 0.0f);
+	}
+	return d;
+}
+
+
+void Initializer::buildTables() {
+	const int w = img.width();
+	const int h = img.height();
+	for (int ch = 0; ch < 3; ++ch) {
+		sum[ch].assign((w + 1) * (h + 1), 0);
+		sumSq[ch].assign((w + 1) * (h + 1), 0);
+	}
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			const Color c{img.get(x, y)};
+			const double v[3] = {static_cast<double>(c.R), static_cast<double>(c.G), static_cast<double>(c.B)};
+			const int k = (y + 1) * (w + 1) + x + 1;
+			for (int ch = 0; ch < 3; ++ch) {
+				sum[ch][k] = v[ch] + sum[ch][k - 1] + sum[ch][k - w - 1] - sum[ch][k - w - 2];
+				sumSq[ch][k] = v[ch] * v[ch] + sumSq[ch][k - 1] + sumSq[ch][k - w - 1] - sumSq[ch][k - w - 2];
+			}
+		}
+	}
+}
+
+
+Color Initializer::meanColor(const Rectangle& r) const {
+	const double n = static_cast<double>(r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1);
+	auto mean = [this, &r, n] (const int ch) {
+		return static_cast<Color::ColorChannel>(std::lround(tableSum(sum[ch], r) / n));
+	};
+	const Color::ColorChannel red = mean(0);
+	const Color::ColorChannel green = mean(1);
+	return Color{red, green, mean(2)};
+}
+
+
+// squared error of r against its mean color
+double Initializer::error(const Rectangle& r) const {
+	const double n = static_cast<double>(r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1);
+	double e = 0;
+	for (int ch = 0; ch < 3; ++ch) {
+		const double s = tableSum(sum[ch], r);
+		e += tableSum(sumSq[ch], r) - s * s / n;
+	}
+	return e;
+}
+
+
+double Initializer::tableSum(const std::vector<double>& t, const Rectangle& r) const {
+	const int stride = img.width() + 1;
+	return t[(r.y1 + 1) * stride + r.x1 + 1] - t[r.y0 * stride + r.x1 + 1]
+	     - t[(r.y1 + 1) * stride + r.x0] + t[r.y0 * stride + r.x0];
+}
+
+
+// r's corners, remaining vertices spread along its edges
+Polygon Initializer::rectPoly(const Rectangle& r) const {
+	const Point corners[4] = {Point{r.x0, r.y0}, Point{r.x1, r.y0}, Point{r.x1, r.y1}, Point{r.x0, r.y1}};
+	const int extra = std::max(vertCount - 4, 0);
+	Polygon p;
+	for (int e = 0; e < 4 && static_cast<int>(p.size()) < vertCount; ++e) {
+		const Point& a = corners[e];
+		const Point& b = corners[(e + 1) % 4];
+		p.add(a);
+		const int n = extra / 4 + (e < extra % 4 ? 1 : 0);
+		for (int i = 1; i <= n; ++i)
+			p.add(a.x + (b.x - a.x) * i / (n + 1), a.y + (b.y - a.y) * i / (n + 1));
+	}
+	return p;
+}
+
+
+// vertCount points on the ellipse at two standard deviations of the covariance
+// (vxx, vxy, vyy) around (cx, cy), clamped to the image
+Polygon Initializer::ellipsePoly(const double cx, const double cy, const double vxx, const double vxy, const double vyy) const {
+	// principal axes
+	const double tr = (vxx + vyy) / 2;
+	const double det = std::sqrt(std::max(tr * tr - (vxx * vyy - vxy * vxy), 0.0));
+	const double l1 = tr + det;
+	const double l2 = std::max(tr - det, 0.0);
+	const double angle = 0.5 * std::atan2(2 * vxy, vxx - vyy);
+	const double a = 2 * std::sqrt(l1);
+	const double b = 2 * std::sqrt(l2);
+	const double ca = std::cos(angle);
+	const double sa = std::sin(angle);
+	Polygon p;
+	for (int i = 0; i < vertCount; ++i) {
+		const double t = 2 * std::acos(-1.0) * i / vertCount;
+		const double ex = a * std::cos(t);
+		const double ey = b * std::sin(t);
+		const int x = static_cast<int>(std::lround(cx + ex * ca - ey * sa));
+		const int y = static_cast<int>(std::lround(cy + ex * sa + ey * ca));
+		p.add(std::min(std::max(x, 0), img.width() - 1), std::min(std::max(y, 0), img.height() - 1));
+	}
+	return p;
+}
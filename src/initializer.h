@@ -0,0 +1,58 @@
+#pragma once
+
+#include "color.h"
+#include "dna.h"
+#include "image.h"
+#include "poly_mutator.h"
+#include "polygon.h"
+#include "rng.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// RANDOM: uniform random polygons (same as img_iter without DNA)
+// SIMPLE: randSimplePoly() in a random local rectangle, colored by its mean
+// QUADTREE: quadrants split by highest color error, drawn coarse to fine
+// KMEANS: clusters of color and position, drawn largest first
+enum class InitStrategy {NONE, RANDOM, SIMPLE, QUADTREE, KMEANS};
+std::string InitStrategyToString(const InitStrategy);
+InitStrategy stringToInitStrategy(const std::string&);
+
+
+// Initial DNA sampled from the source image.
+class Initializer {
+	struct Cluster {
+		double sum[5];	// x, y, R, G, B
+		double xx, xy, yy;	// position moments
+		int n;
+	};
+public:
+	Initializer(const Image&, const int, const std::uint64_t);
+	~Initializer() = default;
+	DNA make(const InitStrategy, const int);
+private:
+	DNA random(const int);
+	DNA simple(const int);
+	DNA quadtree(const int);
+	DNA kmeans(const int);
+	void buildTables(void);
+	Color meanColor(const Rectangle&) const;
+	double error(const Rectangle&) const;
+	double tableSum(const std::vector<double>&, const Rectangle&) const;
+	Polygon rectPoly(const Rectangle&) const;
+	Polygon ellipsePoly(const double, const double, const double, const double, const double) const;
+
+	static constexpr std::uint64_t seedMix = 0x9e3779b97f4a7c15;
+	static constexpr int kmeansSamples = 20000;	// approximate
+	static constexpr int kmeansRounds = 10;
+	static constexpr float kmeansSpatial = 1.0f;	// weight of position against color
+	static constexpr float clusterAlpha = 0.8f;
+	const Image& img;
+	const int vertCount;
+	poly_mutator pm;
+	Random rng;
+	// summed area tables (width + 1 by height + 1) of each channel and its square
+	std::vector<double> sum[3];
+	std::vector<double> sumSq[3];
+};
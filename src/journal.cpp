@@ -0,0 +1,245 @@
+#include "journal.h"
+
+
+constexpr char Journal::magic[];
+
+
+Journal::~Journal() {
+	close();
+}
+
+
+// starts a new journal at path, a keyframe is due every interval mutations
+bool Journal::open(const std::string& path, const int kfInterval) {
+	close();
+	f = std::fopen(path.c_str(), "wb");
+	if (f == nullptr)
+		return false;
+	std::setvbuf(f, nullptr, _IOFBF, 1 << 16);
+	interval = kfInterval;
+	sinceKeyframe = 0;
+	std::fwrite(magic, 1, sizeof(magic), f);
+	payload.clear();
+	put16(version);
+	std::fwrite(payload.data(), 1, payload.size(), f);
+	return std::ferror(f) == 0;
+}
+
+
+void Journal::close() {
+	if (f == nullptr)
+		return;
+	std::fclose(f);
+	f = nullptr;
+}
+
+
+bool Journal::keyframeDue() const {
+	return f != nullptr && sinceKeyframe >= interval;
+}
+
+
+// full DNA at improvement imp, flushed so the file is complete up to here
+void Journal::keyframe(const int imp, const DNA& d) {
+	if (f == nullptr)
+		return;
+	FileHelper::encodeDNABinary(d, payload);
+	append(Record::KEYFRAME, imp);
+	std::fflush(f);
+	sinceKeyframe = 0;
+}
+
+
+// Swap with other, or Remove (other unused)
+void Journal::mutation(const int imp, const Mutation m, const int index, const int other) {
+	if (f == nullptr)
+		return;
+	payload.clear();
+	put8(static_cast<unsigned char>(m));
+	put32(index);
+	if (m == Mutation::Swap)
+		put32(other);
+	append(Record::MUTATION, imp);
+	++sinceKeyframe;
+}
+
+
+// polygon index after mutation m
+void Journal::mutation(const int imp, const Mutation m, const int index, const Polygon& p, const Color& c, const float a) {
+	if (f == nullptr)
+		return;
+	payload.clear();
+	put8(static_cast<unsigned char>(m));
+	put32(index);
+	put16(p.size());
+	put8(c.R);
+	put8(c.G);
+	put8(c.B);
+	put8(0);
+	std::uint32_t bits;
+	std::memcpy(&bits, &a, sizeof(float));
+	put32(bits);
+	const Polygon::Container& v = p.vertices();
+	for (auto it = v.cbegin(); it != v.cend(); ++it) {
+		put32(static_cast<std::uint32_t>((*it).x));
+		put32(static_cast<std::uint32_t>((*it).y));
+	}
+	append(Record::MUTATION, imp);
+	++sinceKeyframe;
+}
+
+
+// DNA after improvement target (or the last one recorded if the journal ends
+// first), reached is set to the improvement it represents
+DNA Journal::replay(const std::string& path, const int target, int& reached, std::string& error) {
+	DNA dnaError;
+	FileHelper::MappedFile file;
+	if (!file.open(path)) {
+		error = "unable to open file";
+		return dnaError;
+	}
+	const unsigned char* data = file.data();
+	const std::size_t size = file.size();
+	if (size < headerSize || std::memcmp(data, magic, sizeof(magic)) != 0) {
+		error = "not a journal";
+		return dnaError;
+	}
+	if ((data[4] | data[5] << 8) != version) {
+		error = "unsupported version";
+		return dnaError;
+	}
+
+	// complete records up to target, and the last keyframe among them
+	std::size_t keyframe = 0;
+	std::size_t end = headerSize;
+	for (std::size_t pos = headerSize; size - pos >= recordHeaderSize + 4; ) {
+		const std::size_t n = get32(data + pos + 5);
+		if (n > size - pos - recordHeaderSize - 4)
+			break;
+		if (static_cast<int>(get32(data + pos + 1)) > target)
+			break;
+		if (data[pos] == static_cast<unsigned char>(Record::KEYFRAME))
+			keyframe = pos;
+		pos += recordHeaderSize + n + 4;
+		end = pos;
+	}
+	if (keyframe == 0) {
+		error = "no keyframe before the improvement";
+		return dnaError;
+	}
+
+	DNA d;
+	for (std::size_t pos = keyframe; pos < end; ) {
+		const unsigned char* body = data + pos + recordHeaderSize;
+		const std::size_t n = get32(data + pos + 5);
+		if (FileHelper::checksum(body, n) != get32(body + n)) {
+			error = "checksum mismatch at improvement " + patch::to_string(get32(data + pos + 1));
+			return dnaError;
+		}
+		if (data[pos] == static_cast<unsigned char>(Record::KEYFRAME)) {
+			d = FileHelper::readDNABinary(body, n, error);
+			if (!error.empty())
+				return dnaError;
+		}
+		else if (data[pos] != static_cast<unsigned char>(Record::MUTATION) || !apply(body, n, d)) {
+			error = "invalid record at improvement " + patch::to_string(get32(data + pos + 1));
+			return dnaError;
+		}
+		reached = get32(data + pos + 1);
+		pos += recordHeaderSize + n + 4;
+	}
+
+	// vertex counts may have changed
+	d.polyCount = d.data.size();
+	d.vertCount = d.data.front().v.size();
+	for (auto it = d.data.cbegin(); it != d.data.cend(); ++it) {
+		if ((*it).v.size() != d.vertCount)
+			d.vertCount = 0;
+	}
+	return d;
+}
+
+
+// writes the record header, payload and its checksum
+void Journal::append(const Record type, const int imp) {
+	const std::uint32_t n = payload.size();
+	unsigned char header[recordHeaderSize];
+	header[0] = static_cast<unsigned char>(type);
+	for (int i = 0; i < 4; ++i) {
+		header[1 + i] = static_cast<std::uint32_t>(imp) >> (8 * i);
+		header[5 + i] = n >> (8 * i);
+	}
+	put32(FileHelper::checksum(payload.data(), n));
+	std::fwrite(header, 1, recordHeaderSize, f);
+	std::fwrite(payload.data(), 1, payload.size(), f);
+}
+
+
+void Journal::put8(const unsigned char v) {
+	payload.push_back(v);
+}
+
+
+void Journal::put16(const std::uint16_t v) {
+	payload.push_back(v);
+	payload.push_back(v >> 8);
+}
+
+
+void Journal::put32(const std::uint32_t v) {
+	put16(v);
+	put16(v >> 16);
+}
+
+
+std::uint32_t Journal::get32(const unsigned char* p) {
+	return static_cast<std::uint32_t>(p[0]) | p[1] << 8 | p[2] << 16 | static_cast<std::uint32_t>(p[3]) << 24;
+}
+
+
+// applies a MUTATION payload to d, false if it does not fit d
+bool Journal::apply(const unsigned char* p, const std::size_t n, DNA& d) {
+	if (n < 5 || p[0] >= poly_mutator::MutationCount)
+		return false;
+	const Mutation m = static_cast<Mutation>(p[0]);
+	const std::size_t index = get32(p + 1);
+	if (m == Mutation::Swap) {
+		if (n != 9)
+			return false;
+		const std::size_t other = get32(p + 5);
+		if (index >= d.data.size() || other >= d.data.size())
+			return false;
+		std::swap(d.data[index], d.data[other]);
+		return true;
+	}
+	if (m == Mutation::Remove) {
+		if (n != 5 || index >= d.data.size() || d.data.size() < 2)
+			return false;
+		d.data.erase(d.data.begin() + index);
+		return true;
+	}
+
+	if (n < 15)
+		return false;
+	const std::size_t vertCount = p[5] | p[6] << 8;
+	if (vertCount < 3 || n != 15 + vertCount * 8)
+		return false;
+	if (m == Mutation::Add) {
+		if (index != d.data.size())
+			return false;
+		d.data.emplace_back();
+	}
+	else if (index >= d.data.size())
+		return false;
+	PolyDNA& pd = d.data[index];
+	pd.color = Color(p[7], p[8], p[9]);
+	const std::uint32_t bits = get32(p + 11);
+	std::memcpy(&pd.alpha, &bits, sizeof(float));
+	pd.v.resize(vertCount);
+	p += 15;
+	for (auto it = pd.v.begin(); it != pd.v.end(); ++it, p += 8) {
+		(*it).x = static_cast<std::int32_t>(get32(p));
+		(*it).y = static_cast<std::int32_t>(get32(p + 4));
+	}
+	return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "dna.h"
+#include "file_helper.h"
+#include "poly_mutator.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+// Append-only record of accepted mutations with periodic full DNA keyframes,
+// so the DNA at any improvement is the last keyframe before it plus the
+// mutations after that keyframe.
+//
+// File: "IIJN" u16 version, then records, little-endian:
+// u8 type, u32 improvement, u32 payload size, payload, u32 FNV-1a of the payload
+// KEYFRAME payload: binary DNA file (see file_helper.h)
+// MUTATION payload: u8 Mutation, u32 polygon index, then
+//   Swap: u32 other index; Remove: nothing;
+//   others: u16 N, u8 R G B, u8 0, f32 A, i32 X Y per vertex, the polygon after
+//   the mutation (Add appends it)
+// A torn record at the end, from a crash while writing, is ignored.
+class Journal {
+public:
+	Journal() = default;
+	Journal(const Journal&) = delete;
+	~Journal();
+	Journal& operator=(const Journal&) = delete;
+	bool open(const std::string&, const int);
+	void close(void);
+	bool keyframeDue(void) const;
+	void keyframe(const int, const DNA&);
+	void mutation(const int, const Mutation, const int, const int);
+	void mutation(const int, const Mutation, const int, const Polygon&, const Color&, const float);
+	static DNA replay(const std::string&, const int, int&, std::string&);
+private:
+	enum class Record : unsigned char {KEYFRAME = 'K', MUTATION = 'M'};
+
+	void append(const Record, const int);
+	void put8(const unsigned char);
+	void put16(const std::uint16_t);
+	void put32(const std::uint32_t);
+	static std::uint32_t get32(const unsigned char*);
+	static bool apply(const unsigned char*, const std::size_t, DNA&);
+
+	static constexpr char magic[4] = {'I', 'I', 'J', 'N'};
+	static constexpr std::uint16_t version = 1;
+	static constexpr std::size_t headerSize = 6;
+	static constexpr std::size_t recordHeaderSize = 9;
+	std::FILE* f = nullptr;
+	std::vector<unsigned char> payload;	// reused between records
+	int interval = 0;	// mutations between keyframes
+	int sinceKeyframe = 0;
+};
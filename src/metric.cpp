@@ -0,0 +1,77 @@
+#include "metric.h"
+
+
+std::string MetricToString(const Metric m) {
+	switch (m) {
+	case Metric::SAD:
+		return "sad";
+	case Metric::SSE:
+		return "sse";
+	case Metric::LUMA:
+		return "luma";
+	case Metric::PERCEPTUAL:
+		return "perceptual";
+	case Metric::NONE:
+	default:
+		return std::string();
+	}
+}
+
+
+Metric stringToMetric(const std::string& s) {
+	if (s == "sad")
+		return Metric::SAD;
+	if (s == "sse")
+		return Metric::SSE;
+	if (s == "luma")
+		return Metric::LUMA;
+	if (s == "perceptual")
+		return Metric::PERCEPTUAL;
+	return Metric::NONE;
+}
+
+
+// On gray pixels each metric is a multiple of |d| or d^2, the gray maximum
+// errors make the accuracy equal to the RGB kernels' on the same pixels.
+FitnessMetric::FitnessMetric(const Metric metric) : m(metric) {
+	switch (m) {
+	case Metric::SSE:
+		use<MetricKernel::SSE, MetricKernel::GRAY_SSE>(255 * 255);
+		break;
+	case Metric::LUMA:
+		use<MetricKernel::LUMA, MetricKernel::GRAY_SAD>(255);
+		break;
+	case Metric::PERCEPTUAL:
+		use<MetricKernel::PERCEPTUAL, MetricKernel::GRAY_SAD>(174 * 255 / 128.0f);	// gray error is 128 |d|
+		break;
+	case Metric::SAD:
+	default:
+		m = Metric::SAD;
+		use<MetricKernel::SAD, MetricKernel::GRAY_SAD>(255);
+		break;
+	}
+}
+
+
+Metric FitnessMetric::type() const {
+	return m;
+}
+
+
+template <class Kernel, class GrayKernel>
+void FitnessMetric::use(const float grayMaxError) {
+	rgb = rows<Kernel>(Kernel::maxError);
+	gray = rows<GrayKernel>(grayMaxError);
+}
+
+
+template <class Kernel>
+FitnessMetric::Rows<typename Kernel::Pixel> FitnessMetric::rows(const float maxError) {
+	Rows<typename Kernel::Pixel> r;
+	r.error = &rowError<Kernel>;
+	r.errorScalar = &rowErrorScalar<Kernel>;
+	r.weightedError = &rowErrorWeighted<Kernel>;
+	r.weightedErrorScalar = &rowErrorWeightedScalar<Kernel>;
+	r.maxError = maxError;
+	return r;
+}
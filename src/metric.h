@@ -0,0 +1,463 @@
+#pragma once
+
+#include "color.h"
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define METRIC_SSE2
+#include <emmintrin.h>
+#endif
+
+
+// SAD: sum of absolute channel differences
+// SSE: sum of squared channel differences
+// LUMA: absolute channel differences weighted by luma (77, 150, 29) / 256
+// PERCEPTUAL: 2 |dY| + |dCb| + |dCr| (YCbCr is linear, so it is taken of the
+// difference and the original needs no conversion)
+enum class Metric {NONE, SAD, SSE, LUMA, PERCEPTUAL};
+std::string MetricToString(const Metric);
+Metric stringToMetric(const std::string&);
+
+
+static_assert(sizeof(Color) == 3, "metric kernels read rows of Color as packed RGB bytes");
+static_assert(sizeof(Gray8) == 1, "metric kernels read rows of Gray8 as bytes");
+
+
+// Error kernels over rows of Pixel. pixel() is the scalar reference, simd()
+// adds the error of step pixels to 32-bit lanes of acc (identical to pixel()
+// summed). The weighted simd() takes a weight byte per channel (R = G = B)
+// and adds the error times the weight; its lanes may overflow after flush
+// steps. The GRAY kernels serve every metric on Gray8 rows, where they only
+// differ in scale.
+namespace MetricKernel {
+#ifdef METRIC_SSE2
+	// adds the 32-bit products of unsigned 16-bit t and w to acc
+	inline __m128i mulAdd(const __m128i t, const __m128i w, __m128i acc) {
+		const __m128i lo = _mm_mullo_epi16(t, w);
+		const __m128i hi = _mm_mulhi_epu16(t, w);
+		acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(lo, hi));
+		return _mm_add_epi32(acc, _mm_unpackhi_epi16(lo, hi));
+	}
+#endif
+
+	struct SAD {
+		typedef Color Pixel;
+		static constexpr int maxError = 3 * 255;
+		static constexpr int step = 16;
+		static int pixel(const Color& a, const Color& b) {
+			return std::abs(a.R - b.R) + std::abs(a.G - b.G) + std::abs(a.B - b.B);
+		}
+#ifdef METRIC_SSE2
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, __m128i acc) {
+			for (int k = 0; k < 48; k += 16) {
+				const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + k));
+				const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + k));
+				acc = _mm_add_epi32(acc, _mm_sad_epu8(va, vb));
+			}
+			return acc;
+		}
+
+		static constexpr int flush = 4096;
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, const std::uint8_t* w, __m128i acc) {
+			const __m128i zero = _mm_setzero_si128();
+			for (int k = 0; k < 48; k += 16) {
+				const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + k));
+				const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + k));
+				const __m128i vw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + k));
+				const __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(vw, zero)));
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(vw, zero)));
+			}
+			return acc;
+		}
+#endif
+	};
+
+	struct SSE {
+		typedef Color Pixel;
+		static constexpr int maxError = 3 * 255 * 255;
+		static constexpr int step = 16;
+		static int pixel(const Color& a, const Color& b) {
+			const int r = a.R - b.R;
+			const int g = a.G - b.G;
+			const int bl = a.B - b.B;
+			return r * r + g * g + bl * bl;
+		}
+#ifdef METRIC_SSE2
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, __m128i acc) {
+			const __m128i zero = _mm_setzero_si128();
+			for (int k = 0; k < 48; k += 16) {
+				const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + k));
+				const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + k));
+				const __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+				const __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(lo, lo));
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(hi, hi));
+			}
+			return acc;
+		}
+
+		// squares (< 2^16) are multiplied as unsigned 16-bit
+		static constexpr int flush = 16;
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, const std::uint8_t* w, __m128i acc) {
+			const __m128i zero = _mm_setzero_si128();
+			for (int k = 0; k < 48; k += 16) {
+				const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + k));
+				const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + k));
+				const __m128i vw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + k));
+				const __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+				const __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+				acc = mulAdd(_mm_mullo_epi16(lo, lo), _mm_unpacklo_epi8(vw, zero), acc);
+				acc = mulAdd(_mm_mullo_epi16(hi, hi), _mm_unpackhi_epi8(vw, zero), acc);
+			}
+			return acc;
+		}
+#endif
+	};
+
+	struct LUMA {
+		typedef Color Pixel;
+		static constexpr int maxError = 256 * 255;
+		static constexpr int step = 16;
+		static int pixel(const Color& a, const Color& b) {
+			return 77 * std::abs(a.R - b.R) + 150 * std::abs(a.G - b.G) + 29 * std::abs(a.B - b.B);
+		}
+#ifdef METRIC_SSE2
+		// 48 bytes start on R, then the 16 byte chunks start on R, G and B
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, __m128i acc) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i w[6] = {
+				_mm_setr_epi16(77, 150, 29, 77, 150, 29, 77, 150), _mm_setr_epi16(29, 77, 150, 29, 77, 150, 29, 77),
+				_mm_setr_epi16(150, 29, 77, 150, 29, 77, 150, 29), _mm_setr_epi16(77, 150, 29, 77, 150, 29, 77, 150),
+				_mm_setr_epi16(29, 77, 150, 29, 77, 150, 29, 77), _mm_setr_epi16(150, 29, 77, 150, 29, 77, 150, 29)
+			};
+			for (int k = 0; k < 3; ++k) {
+				const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 16 * k));
+				const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 16 * k));
+				const __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(d, zero), w[2 * k]));
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(d, zero), w[2 * k + 1]));
+			}
+			return acc;
+		}
+
+		// luma weighted differences (< 2^16) are multiplied as unsigned 16-bit
+		static constexpr int flush = 32;
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, const std::uint8_t* w, __m128i acc) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i l[6] = {
+				_mm_setr_epi16(77, 150, 29, 77, 150, 29, 77, 150), _mm_setr_epi16(29, 77, 150, 29, 77, 150, 29, 77),
+				_mm_setr_epi16(150, 29, 77, 150, 29, 77, 150, 29), _mm_setr_epi16(77, 150, 29, 77, 150, 29, 77, 150),
+				_mm_setr_epi16(29, 77, 150, 29, 77, 150, 29, 77), _mm_setr_epi16(150, 29, 77, 150, 29, 77, 150, 29)
+			};
+			for (int k = 0; k < 3; ++k) {
+				const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 16 * k));
+				const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 16 * k));
+				const __m128i vw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + 16 * k));
+				const __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+				acc = mulAdd(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), l[2 * k]), _mm_unpacklo_epi8(vw, zero), acc);
+				acc = mulAdd(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), l[2 * k + 1]), _mm_unpackhi_epi8(vw, zero), acc);
+			}
+			return acc;
+		}
+#endif
+	};
+
+	// YCbCr weights scaled by 64, error in 1/64 units
+	struct PERCEPTUAL {
+		typedef Color Pixel;
+		static constexpr int maxError = 174 * 255;	// largest at (255, 255, -255)
+		static constexpr int step = 8;
+		static int pixel(const Color& a, const Color& b) {
+			const int r = a.R - b.R;
+			const int g = a.G - b.G;
+			const int bl = a.B - b.B;
+			const int y = 19 * r + 38 * g + 7 * bl;
+			const int cb = -11 * r - 21 * g + 32 * bl;
+			const int cr = 32 * r - 27 * g - 5 * bl;
+			return 2 * std::abs(y) + std::abs(cb) + std::abs(cr);
+		}
+#ifdef METRIC_SSE2
+		// Channels of 8 pixels are gathered with masks: R lands in lane order
+		// 0 3 6 1 4 7 2 5, and G and B are rotated into the same order.
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, __m128i acc) {
+			__m128i y, cb, cr;
+			terms(a, b, y, cb, cr);
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(y, _mm_set1_epi16(2)));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(cb, _mm_set1_epi16(1)));
+			return _mm_add_epi32(acc, _mm_madd_epi16(cr, _mm_set1_epi16(1)));
+		}
+
+		// weights are gathered like R
+		static constexpr int flush = 64;
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, const std::uint8_t* w, __m128i acc) {
+			__m128i y, cb, cr;
+			terms(a, b, y, cb, cr);
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i w0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w));
+			const __m128i w1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(w + 16));
+			const __m128i vw = gather(_mm_unpacklo_epi8(w0, zero), _mm_unpackhi_epi8(w0, zero), _mm_unpacklo_epi8(w1, zero), 0);
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(y, _mm_add_epi16(vw, vw)));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(cb, vw));
+			return _mm_add_epi32(acc, _mm_madd_epi16(cr, vw));
+		}
+
+		// lanes of channel c (0 R, 1 G, 2 B) from the 16-bit values of 24 bytes
+		static __m128i gather(const __m128i v0, const __m128i v1, const __m128i v2, const int c) {
+			const __m128i m036 = _mm_setr_epi16(-1, 0, 0, -1, 0, 0, -1, 0);
+			const __m128i m147 = _mm_setr_epi16(0, -1, 0, 0, -1, 0, 0, -1);
+			const __m128i m25 = _mm_setr_epi16(0, 0, -1, 0, 0, -1, 0, 0);
+			if (c == 0)
+				return _mm_or_si128(_mm_or_si128(_mm_and_si128(v0, m036), _mm_and_si128(v1, m147)), _mm_and_si128(v2, m25));
+			if (c == 1) {
+				const __m128i g = _mm_or_si128(_mm_or_si128(_mm_and_si128(v0, m147), _mm_and_si128(v1, m25)), _mm_and_si128(v2, m036));
+				return _mm_or_si128(_mm_srli_si128(g, 2), _mm_slli_si128(g, 14));
+			}
+			const __m128i bl = _mm_or_si128(_mm_or_si128(_mm_and_si128(v0, m25), _mm_and_si128(v1, m036)), _mm_and_si128(v2, m147));
+			return _mm_or_si128(_mm_srli_si128(bl, 4), _mm_slli_si128(bl, 12));
+		}
+
+		// |Y|, |Cb| and |Cr| of the differences of 8 pixels
+		static void terms(const std::uint8_t* a, const std::uint8_t* b, __m128i& y, __m128i& cb, __m128i& cr) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+			const __m128i a1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + 16));
+			const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+			const __m128i b1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + 16));
+			const __m128i d0 = _mm_sub_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+			const __m128i d1 = _mm_sub_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+			const __m128i d2 = _mm_sub_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+			const __m128i r = gather(d0, d1, d2, 0);
+			const __m128i g = gather(d0, d1, d2, 1);
+			const __m128i bl = gather(d0, d1, d2, 2);
+			auto mix = [&r, &g, &bl] (const short wr, const short wg, const short wb) {
+				const __m128i v = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(wr)),
+				                                              _mm_mullo_epi16(g, _mm_set1_epi16(wg))),
+				                                _mm_mullo_epi16(bl, _mm_set1_epi16(wb)));
+				return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+			};
+			y = mix(19, 38, 7);
+			cb = mix(-11, -21, 32);
+			cr = mix(32, -27, -5);
+		}
+#endif
+	};
+
+	struct GRAY_SAD {
+		typedef Gray8 Pixel;
+		static constexpr int step = 16;
+		static int pixel(const Gray8& a, const Gray8& b) {
+			return std::abs(a.V - b.V);
+		}
+#ifdef METRIC_SSE2
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, __m128i acc) {
+			const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+			const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+			return _mm_add_epi32(acc, _mm_sad_epu8(va, vb));
+		}
+
+		static constexpr int flush = 8192;
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, const std::uint8_t* w, __m128i acc) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+			const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+			const __m128i vw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w));
+			const __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(vw, zero)));
+			return _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(vw, zero)));
+		}
+#endif
+	};
+
+	struct GRAY_SSE {
+		typedef Gray8 Pixel;
+		static constexpr int step = 16;
+		static int pixel(const Gray8& a, const Gray8& b) {
+			const int d = a.V - b.V;
+			return d * d;
+		}
+#ifdef METRIC_SSE2
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, __m128i acc) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+			const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+			const __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+			const __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(lo, lo));
+			return _mm_add_epi32(acc, _mm_madd_epi16(hi, hi));
+		}
+
+		static constexpr int flush = 32;
+		static __m128i simd(const std::uint8_t* a, const std::uint8_t* b, const std::uint8_t* w, __m128i acc) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+			const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+			const __m128i vw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w));
+			const __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+			const __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+			acc = mulAdd(_mm_mullo_epi16(lo, lo), _mm_unpacklo_epi8(vw, zero), acc);
+			return mulAdd(_mm_mullo_epi16(hi, hi), _mm_unpackhi_epi8(vw, zero), acc);
+		}
+#endif
+	};
+}
+
+
+// weight of a pixel of a weight row
+inline int pixelWeight(const Color& w) {
+	return w.R;
+}
+
+
+inline int pixelWeight(const Gray8& w) {
+	return w.V;
+}
+
+
+// summed error of n pixels (scalar reference)
+template <class Kernel>
+std::uint64_t rowErrorScalar(const typename Kernel::Pixel* a, const typename Kernel::Pixel* b, const int n) {
+	std::uint64_t e = 0;
+	for (int x = 0; x < n; ++x)
+		e += Kernel::pixel(a[x], b[x]);
+	return e;
+}
+
+
+// summed error of n pixels
+template <class Kernel>
+std::uint64_t rowError(const typename Kernel::Pixel* a, const typename Kernel::Pixel* b, const int n) {
+	int x = 0;
+	std::uint64_t e = 0;
+#ifdef METRIC_SSE2
+	const int bytes = sizeof(typename Kernel::Pixel);
+	const std::uint8_t* pa = reinterpret_cast<const std::uint8_t*>(a);
+	const std::uint8_t* pb = reinterpret_cast<const std::uint8_t*>(b);
+	__m128i acc = _mm_setzero_si128();
+	for (; x + Kernel::step <= n; x += Kernel::step)
+		acc = Kernel::simd(pa + bytes * x, pb + bytes * x, acc);
+	std::uint32_t lanes[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+	e = static_cast<std::uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+#endif
+	return e + rowErrorScalar<Kernel>(a + x, b + x, n - x);
+}
+
+
+// summed error of n pixels times their weight (scalar reference)
+template <class Kernel>
+std::uint64_t rowErrorWeightedScalar(const typename Kernel::Pixel* a, const typename Kernel::Pixel* b,
+                                     const typename Kernel::Pixel* w, const int n) {
+	std::uint64_t e = 0;
+	for (int x = 0; x < n; ++x)
+		e += static_cast<std::uint64_t>(pixelWeight(w[x])) * Kernel::pixel(a[x], b[x]);
+	return e;
+}
+
+
+// summed error of n pixels times their weight (w has R = G = B)
+template <class Kernel>
+std::uint64_t rowErrorWeighted(const typename Kernel::Pixel* a, const typename Kernel::Pixel* b,
+                               const typename Kernel::Pixel* w, const int n) {
+	int x = 0;
+	std::uint64_t e = 0;
+#ifdef METRIC_SSE2
+	const int bytes = sizeof(typename Kernel::Pixel);
+	const std::uint8_t* pa = reinterpret_cast<const std::uint8_t*>(a);
+	const std::uint8_t* pb = reinterpret_cast<const std::uint8_t*>(b);
+	const std::uint8_t* pw = reinterpret_cast<const std::uint8_t*>(w);
+	while (x + Kernel::step <= n) {
+		__m128i acc = _mm_setzero_si128();
+		for (int k = 0; k < Kernel::flush && x + Kernel::step <= n; ++k, x += Kernel::step)
+			acc = Kernel::simd(pa + bytes * x, pb + bytes * x, pw + bytes * x, acc);
+		std::uint32_t lanes[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+		e += static_cast<std::uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+	}
+#endif
+	return e + rowErrorWeightedScalar<Kernel>(a + x, b + x, w + x, n - x);
+}
+
+
+// summed weight of n pixels (w has R = G = B)
+template <class Pixel>
+std::uint64_t rowWeight(const Pixel* w, const int n) {
+	const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(w);
+	const int bytes = sizeof(Pixel) * n;
+	int k = 0;
+	std::uint64_t s = 0;
+#ifdef METRIC_SSE2
+	__m128i acc = _mm_setzero_si128();
+	for (; k + 16 <= bytes; k += 16)
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + k)), _mm_setzero_si128()));
+	std::uint64_t lanes[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+	s = lanes[0] + lanes[1];
+#endif
+	for (; k < bytes; ++k)
+		s += p[k];
+	return s / sizeof(Pixel);
+}
+
+
+// Accuracy of rows under one metric. Kernels are instantiated per metric and
+// pixel type so their pixel loops are inlined, the metric is picked once per
+// row.
+class FitnessMetric {
+	template <class Pixel>
+	struct Rows {
+		std::uint64_t (*error)(const Pixel*, const Pixel*, const int);
+		std::uint64_t (*errorScalar)(const Pixel*, const Pixel*, const int);
+		std::uint64_t (*weightedError)(const Pixel*, const Pixel*, const Pixel*, const int);
+		std::uint64_t (*weightedErrorScalar)(const Pixel*, const Pixel*, const Pixel*, const int);
+		float maxError;
+	};
+public:
+	explicit FitnessMetric(const Metric);
+	~FitnessMetric() = default;
+	Metric type(void) const;
+	template <class Pixel> float accuracy(const Pixel*, const Pixel*, const int) const;
+	template <class Pixel> float accuracy(const Pixel*, const Pixel*, const Pixel*, const int) const;
+private:
+	template <class Kernel, class GrayKernel> void use(const float);
+	template <class Kernel> static Rows<typename Kernel::Pixel> rows(const float);
+	const Rows<Color>& rowsOf(const Color*) const;
+	const Rows<Gray8>& rowsOf(const Gray8*) const;
+
+	Metric m;
+	Rows<Color> rgb;
+	Rows<Gray8> gray;	// scaled to match rgb on gray pixels
+};
+
+
+inline const FitnessMetric::Rows<Color>& FitnessMetric::rowsOf(const Color*) const {
+	return rgb;
+}
+
+
+inline const FitnessMetric::Rows<Gray8>& FitnessMetric::rowsOf(const Gray8*) const {
+	return gray;
+}
+
+
+// summed accuracy ([0, 1] per pixel, 1 being equal) of n pixels
+template <class Pixel>
+float FitnessMetric::accuracy(const Pixel* a, const Pixel* b, const int n) const {
+	const Rows<Pixel>& r = rowsOf(a);
+	const std::uint64_t e = r.error(a, b, n);
+	assert(e == r.errorScalar(a, b, n));
+	return n - static_cast<float>(e) / r.maxError;
+}
+
+
+// summed accuracy of n pixels, each scaled by its weight w / 255 (w has R = G = B)
+template <class Pixel>
+float FitnessMetric::accuracy(const Pixel* a, const Pixel* b, const Pixel* w, const int n) const {
+	const Rows<Pixel>& r = rowsOf(a);
+	const std::uint64_t e = r.weightedError(a, b, w, n);
+	assert(e == r.weightedErrorScalar(a, b, w, n));
+	return (static_cast<float>(rowWeight(w, n)) - static_cast<float>(e) / r.maxError) / 255;
+}
@@ -0,0 +1,144 @@
+#include "operator_selector.h"
+#include "checkpoint.h"
+
+
+OperatorSelector::OperatorSelector(const int n)
+: on(n, true), prob(n, 0), quality(n, 0), st(n) {
+	reset();
+}
+
+
+void OperatorSelector::setAdaptive(const bool a) {
+	isAdaptive = a;
+	reset();
+}
+
+
+bool OperatorSelector::adaptive() const {
+	return isAdaptive;
+}
+
+
+void OperatorSelector::setEnabled(const int op, const bool e) {
+	on[op] = e;
+	reset();
+	assert(enabledCount() > 0);
+}
+
+
+bool OperatorSelector::enabled(const int op) const {
+	return on[op];
+}
+
+
+int OperatorSelector::count() const {
+	return on.size();
+}
+
+
+// u in [0, 1)
+int OperatorSelector::select(const float u) const {
+	float sum = 0;
+	int last = 0;
+	for (int i = 0; i < count(); ++i) {
+		if (!on[i])
+			continue;
+		sum += prob[i];
+		if (u < sum)
+			return i;
+		last = i;
+	}
+	return last;	// rounding
+}
+
+
+// result of evaluating a candidate made by operator op
+void OperatorSelector::report(const int op, const bool accepted, const float cost) {
+	Stats& s = st[op];
+	++s.trials;
+	if (accepted)
+		++s.accepts;
+	s.cost += cost;
+	if (!isAdaptive)
+		return;
+
+	const float reward = accepted ? 1.0f / std::max(cost, 1.0f) : 0.0f;
+	quality[op] += alpha * (reward - quality[op]);
+
+	// pursue the operator with the best quality
+	const int n = enabledCount();
+	const float pMin = minShare / n;
+	const float pMax = 1.0f - (n - 1) * pMin;
+	int bestOp = -1;
+	for (int i = 0; i < count(); ++i) {
+		if (on[i] && (bestOp < 0 || quality[i] > quality[bestOp]))
+			bestOp = i;
+	}
+	for (int i = 0; i < count(); ++i) {
+		if (!on[i])
+			continue;
+		const float target = (i == bestOp) ? pMax : pMin;
+		prob[i] += beta * (target - prob[i]);
+	}
+}
+
+
+float OperatorSelector::probability(const int op) const {
+	return prob[op];
+}
+
+
+const OperatorSelector::Stats& OperatorSelector::stats(const int op) const {
+	return st[op];
+}
+
+
+void OperatorSelector::save(CheckpointWriter& w) const {
+	w.put8(isAdaptive);
+	w.put32(count());
+	for (int i = 0; i < count(); ++i) {
+		w.put8(on[i]);
+		w.putFloat(prob[i]);
+		w.putFloat(quality[i]);
+		w.put32(st[i].trials);
+		w.put32(st[i].accepts);
+		w.putDouble(st[i].cost);
+	}
+}
+
+
+// false if the checkpoint is for a different operator set
+bool OperatorSelector::load(CheckpointReader& r) {
+	isAdaptive = r.get8() != 0;
+	if (static_cast<int>(r.get32()) != count())
+		return false;
+	for (int i = 0; i < count(); ++i) {
+		on[i] = r.get8() != 0;
+		prob[i] = r.getFloat();
+		quality[i] = r.getFloat();
+		st[i].trials = r.get32();
+		st[i].accepts = r.get32();
+		st[i].cost = r.getDouble();
+	}
+	return r.good() && enabledCount() > 0;
+}
+
+
+// uniform over enabled operators, optimistic quality so each is tried
+void OperatorSelector::reset() {
+	const int n = enabledCount();
+	for (int i = 0; i < count(); ++i) {
+		prob[i] = (on[i] && n > 0) ? 1.0f / n : 0.0f;
+		quality[i] = 1.0f;
+	}
+}
+
+
+int OperatorSelector::enabledCount() const {
+	int n = 0;
+	for (auto it = on.cbegin(); it != on.cend(); ++it) {
+		if (*it)
+			++n;
+	}
+	return n;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+
+class CheckpointReader;
+class CheckpointWriter;
+
+
+// Chooses mutation operators. By default every enabled operator is equally
+// likely; when adaptive, probabilities follow adaptive pursuit (Thierens 2005)
+// on the acceptance rate per unit of evaluation cost.
+class OperatorSelector {
+public:
+	struct Stats {
+		unsigned int trials = 0;
+		unsigned int accepts = 0;
+		double cost = 0;	// blocks evaluated
+	};
+	explicit OperatorSelector(const int);
+	~OperatorSelector() = default;
+	void setAdaptive(const bool);
+	bool adaptive(void) const;
+	void setEnabled(const int, const bool);
+	bool enabled(const int) const;
+	int count(void) const;
+	int select(const float) const;
+	void report(const int, const bool, const float);
+	float probability(const int) const;
+	const Stats& stats(const int) const;
+	void save(CheckpointWriter&) const;
+	bool load(CheckpointReader&);
+private:
+	void reset(void);
+	int enabledCount(void) const;
+
+	static constexpr float alpha = 0.01f;	// reward learning rate
+	static constexpr float beta = 0.01f;	// probability learning rate
+	static constexpr float minShare = 0.25f;	// each operator keeps minShare / enabled
+	bool isAdaptive = false;
+	std::vector<bool> on;
+	std::vector<float> prob;
+	std::vector<float> quality;	// smoothed reward
+	std::vector<Stats> st;
+};
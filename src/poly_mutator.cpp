@@ -1,35 +1,27 @@
 #include "poly_mutator.h"
+#include "checkpoint.h"
 
 
-std::uniform_int_distribution<int> poly_mutator::distMut = std::uniform_int_distribution<int>(0, poly_mutator::MutationCount - 1);
-std::uniform_int_distribution<uint_fast32_t> poly_mutator::distAlpha = std::uniform_int_distribution<uint_fast32_t>(0);
-std::uniform_int_distribution<Color::ColorChannel> poly_mutator::distCol = std::uniform_int_distribution<Color::ColorChannel>{Color::minColorChannel, Color::maxColorChannel};
-
-
-poly_mutator::poly_mutator(const int pc, const int vc, const int w, const int h)
-: polyCount(pc), vertCount(vc), width(w), height(h) {
-	std::random_device rd;
-	re = std::default_random_engine(rd());
-	distNorm = std::normal_distribution<float>{0.0, 0.4};
-	distUni = std::uniform_real_distribution<float>{0.0, 1.0};
-	distVertX = std::uniform_int_distribution<int>(0, w - 1);
-	distVertY = std::uniform_int_distribution<int>(0, h - 1);
-	distPolyIndex = std::uniform_int_distribution<std::size_t>(0, pc - 1);
-	distVertIndex = std::uniform_int_distribution<std::size_t>(0, vc - 1);
+// seed selects the random sequence (same seed, same run)
+poly_mutator::poly_mutator(const int vc, const int w, const int h, const std::uint64_t seed)
+: vertCount(vc), width(w), height(h),
+  moveStep(std::max(1.0f, moveSigma * std::max(w, h))), rng(seed, 0), selector(MutationCount) {
 }
 
 
 /*
 Generate a random simple polygon inside a rectangle
 vert is number of vertices (>= 3)
-width, height are dimensions of rectangle
+r is the rectangle (inclusive)
 spacing (0 - 1 inclusive) determines random spacing along circle
 sharpness (0 - 1 inclusive) determines how spiky polygon will be
 */
-Polygon poly_mutator::randSimplePoly(const float spacing, const float sharpness) {
+Polygon poly_mutator::randSimplePoly(const Rectangle& r, const float spacing, const float sharpness) {
+	const int w = r.x1 - r.x0 + 1;
+	const int h = r.y1 - r.y0 + 1;
 	// get center of poly close to rectangle center with padding from edge
-	const int cenX = static_cast<int>((width / 2) + (randNorm() * width / 3));
-	const int cenY = static_cast<int>((height / 2) + (randNorm() * height / 3));
+	const int cenX = r.x0 + static_cast<int>((w / 2) + (randNorm() * w / 3));
+	const int cenY = r.y0 + static_cast<int>((h / 2) + (randNorm() * h / 3));
 	// polygon vertices
 	Polygon::Container v;
 	v.reserve(vertCount);
@@ -39,7 +31,7 @@ Polygon poly_mutator::randSimplePoly(const float spacing, const float sharpness)
 	float rad = randUni() * 2 * PI;
 	for (int vert = 0; vert < vertCount; ++vert, rad += radInc) {
 		float radRand = rad + radInc * randNorm() / 2.1 * spacing;
-		std::pair<float, float> intPoint = getPos(cenX, cenY, radRand, width, height);
+		std::pair<float, float> intPoint = getPos(cenX, cenY, radRand, r);
 		// vector from center to intersection
 		float vx = intPoint.first - static_cast<float>(cenX);
 		float vy = intPoint.second - static_cast<float>(cenY);
@@ -47,22 +39,40 @@ Polygon poly_mutator::randSimplePoly(const float spacing, const float sharpness)
 		float vMult = randNorm();
 		float dx = (vx / 2) * (1.0 + vMult * sharpness);
 		float dy = (vy / 2) * (1.0 + vMult * sharpness);
-		p.x = static_cast<int>(cenX + dx);
-		p.y = static_cast<int>(cenY + dy);
+		p.x = clamp(static_cast<int>(cenX + dx), r.x0, r.x1);
+		p.y = clamp(static_cast<int>(cenY + dy), r.y0, r.y1);
 		v.push_back(p);
 	}
 	return Polygon(v);
 }
 
 
+// inside the whole image
+Polygon poly_mutator::randSimplePoly(const float spacing, const float sharpness) {
+	Rectangle r;
+	r.x0 = 0;
+	r.y0 = 0;
+	r.x1 = width - 1;
+	r.y1 = height - 1;
+	return randSimplePoly(r, spacing, sharpness);
+}
+
+
+// random spacing and sharpness
+Polygon poly_mutator::randSimplePoly() {
+	const float spacing = randUni();
+	return randSimplePoly(spacing, randUni());
+}
+
+
 // actually random...
 Polygon poly_mutator::randPoly() {
 	Polygon::Container v;
 	v.reserve(vertCount);
 	Point p;
 	for (int i = 0; i < vertCount; ++i) {
-		p.x = distVertX(re);
-		p.y = distVertY(re);
+		p.x = rng.bounded(width);
+		p.y = rng.bounded(height);
 		v.push_back(p);
 	}
 	return Polygon{v};
@@ -70,57 +80,221 @@ Polygon poly_mutator::randPoly() {
 
 
 Color poly_mutator::randColor() {
+	if (grayColors) {
+		const Color::ColorChannel v = randColChannel();
+		return Color{v, v, v};
+	}
 	return Color{randColChannel(), randColChannel(), randColChannel()};
 }
 
 
 Color::ColorChannel poly_mutator::randColChannel() {
-	return distCol(re);
+	return static_cast<Color::ColorChannel>(rng.bounded(Color::maxColorChannel + 1));
 }
 
 
 float poly_mutator::randAlpha() {
-	return static_cast<float>(distAlpha(re)) / alphaDiv;
+	return rng.uniformClosed();
+}
+
+
+// vertex moved by a normal step, kept inside the image
+Point poly_mutator::perturbVert(const Point& p) {
+	const int x = clamp(p.x + randStep(moveStep), 0, width - 1);
+	return Point{x, clamp(p.y + randStep(moveStep), 0, height - 1)};
+}
+
+
+// normal step (dx, dy) that keeps bounds inside the image
+void poly_mutator::randOffset(const Rectangle& bounds, int& dx, int& dy) {
+	dx = clamp(randStep(moveStep), -bounds.x0, width - 1 - bounds.x1);
+	dy = clamp(randStep(moveStep), -bounds.y0, height - 1 - bounds.y1);
+}
+
+
+// all channels moved by independent normal steps (one step for gray colors)
+Color poly_mutator::perturbColor(const Color& c) {
+	auto channel = [this] (const Color::ColorChannel cc) {
+		return static_cast<Color::ColorChannel>(clamp(cc + randStep(colorSigma), 0, Color::maxColorChannel));
+	};
+	const Color::ColorChannel r = channel(c.R);
+	if (grayColors)
+		return Color{r, r, r};
+	const Color::ColorChannel g = channel(c.G);
+	return Color{r, g, channel(c.B)};
 }
 
 
 Mutation poly_mutator::randMutation() {
-	switch(distMut(re)) {
-	case 0:
-		return Mutation::X;
-	case 1:
-		return Mutation::Y;
-	case 2:
-		return Mutation::R;
-	case 3:
-		return Mutation::G;
-	case 4:
-		return Mutation::B;
-	case 5:
-		return Mutation::A;
+	return static_cast<Mutation>(selector.select(rng.uniform()));
+}
+
+
+// result of evaluating a mutation, cost in blocks evaluated
+void poly_mutator::reportMutation(const Mutation m, const bool accepted, const float cost) {
+	selector.report(static_cast<int>(m), accepted, cost);
+}
+
+
+OperatorSelector& poly_mutator::operators() {
+	return selector;
+}
+
+
+const OperatorSelector& poly_mutator::operators() const {
+	return selector;
+}
+
+
+const char* poly_mutator::mutationName(const Mutation m) {
+	switch (m) {
+	case Mutation::X:
+		return "X";
+	case Mutation::Y:
+		return "Y";
+	case Mutation::R:
+		return "R";
+	case Mutation::G:
+		return "G";
+	case Mutation::B:
+		return "B";
+	case Mutation::A:
+		return "A";
+	case Mutation::Vertex:
+		return "XY";
+	case Mutation::Translate:
+		return "Move";
+	case Mutation::Swap:
+		return "Z";
+	case Mutation::RGB:
+		return "RGB";
+	case Mutation::Replace:
+		return "New";
+	case Mutation::Fit:
+		return "Fit";
+	case Mutation::Search:
+		return "Walk";
+	case Mutation::Add:
+		return "Add";
+	case Mutation::Remove:
+		return "Del";
+	case Mutation::AddVert:
+		return "AddV";
+	case Mutation::RemoveVert:
+		return "DelV";
 	default:
-		return Mutation::X;	// shouldn't happen
+		return "?";
 	}
 }
 
 
-std::size_t poly_mutator::randPolyIndex() {
-	return distPolyIndex(re);
+// random index of count polygons
+std::size_t poly_mutator::randPolyIndex(const std::size_t count) {
+	return rng.bounded(count);
 }
 
 
-std::size_t poly_mutator::randVertIndex() {
-	return distVertIndex(re);
+// random index of count vertices
+std::size_t poly_mutator::randVertIndex(const std::size_t count) {
+	return rng.bounded(count);
 }
 
 
+// when guided, usually inside a block chosen by error
 int poly_mutator::randVertX() {
-	return distVertX(re);
+	if (useSampler()) {
+		const int k = sampler->sample(randUni());
+		if (k >= 0) {
+			const Rectangle r{sampler->blockRect(k)};
+			return randRange(r.x0, r.x1);
+		}
+	}
+	return rng.bounded(width);
 }
 
 
 int poly_mutator::randVertY() {
-	return distVertY(re);
+	if (useSampler()) {
+		const int k = sampler->sample(randUni());
+		if (k >= 0) {
+			const Rectangle r{sampler->blockRect(k)};
+			return randRange(r.y0, r.y1);
+		}
+	}
+	return rng.bounded(height);
+}
+
+
+// block index chosen by error, -1 if not guided (or this draw explores uniformly)
+int poly_mutator::randBlock() {
+	if (useSampler())
+		return sampler->sample(randUni());
+	return -1;
+}
+
+
+// random index in [0, n)
+std::size_t poly_mutator::randIndex(const std::size_t n) {
+	return rng.bounded(n);
+}
+
+
+// sampler is owned by caller, nullptr samples uniformly
+void poly_mutator::setSampler(const ErrorSampler* es) {
+	sampler = es;
+}
+
+
+// only propose gray colors (R mutates all channels, G and B should be disabled)
+void poly_mutator::setGray(const bool g) {
+	grayColors = g;
+}
+
+
+bool poly_mutator::gray() const {
+	return grayColors;
+}
+
+
+int poly_mutator::vertexCount() const {
+	return vertCount;
+}
+
+
+// random state, operator probabilities and color mode; the sampler is owned
+// by img_iter and saved there
+void poly_mutator::save(CheckpointWriter& w) const {
+	std::uint64_t state[Random::stateSize];
+	rng.getState(state);
+	for (std::size_t i = 0; i < Random::stateSize; ++i)
+		w.put64(state[i]);
+	selector.save(w);
+	w.put8(grayColors);
+}
+
+
+bool poly_mutator::load(CheckpointReader& r) {
+	std::uint64_t state[Random::stateSize];
+	for (std::size_t i = 0; i < Random::stateSize; ++i)
+		state[i] = r.get64();
+	if (!r.good())
+		return false;
+	rng.setState(state);
+	if (!selector.load(r))
+		return false;
+	grayColors = r.get8() != 0;
+	return r.good();
+}
+
+
+bool poly_mutator::useSampler() {
+	return (sampler != nullptr) && (randUni() < guidedRate);
+}
+
+
+// random int in [lo, hi]
+int poly_mutator::randRange(const int lo, const int hi) {
+	return lo + static_cast<int>(rng.bounded(hi - lo + 1));
 }
 
 
@@ -128,40 +302,56 @@ int poly_mutator::randVertY() {
 float poly_mutator::randNorm() {
 	float ret;
 	do {
-		ret = distNorm(re);
+		ret = rng.normal() * normSigma;
 	} while (ret >= 1.0 || ret <= -1.0);
 	return ret;
 }
 
 
 float poly_mutator::randUni() {
-	return distUni(re);
+	return rng.uniform();
 }
 
 
-std::pair<float, float> poly_mutator::getPos(const int cx, const int cy, const float rad, const int w, const int h) {
+// non-zero normal step
+int poly_mutator::randStep(const float sigma) {
+	const int step = static_cast<int>(std::lround(rng.normal() * sigma));
+	if (step != 0)
+		return step;
+	return (rng.next() & 1) ? 1 : -1;
+}
+
+
+int poly_mutator::clamp(const int v, const int lo, const int hi) {
+	return std::min(std::max(v, lo), hi);
+}
+
+
+// where a ray from (cx, cy) at angle rad leaves r
+std::pair<float, float> poly_mutator::getPos(const int cx, const int cy, const float rad, const Rectangle& r) {
 	float ix;	// intersection
 	float iy;
 	float fcx = static_cast<float>(cx);
 	float fcy = static_cast<float>(cy);
-	// end points of a line from center that extends beyond rect
-	float ex = std::cos(rad) * (w + h);
-	float ey = std::sin(rad) * (w + h);
+	// end point of a line from center that extends beyond rect
+	const float len = (r.x1 - r.x0) + (r.y1 - r.y0) + 2;
+	float ex = fcx + std::cos(rad) * len;
+	float ey = fcy + std::sin(rad) * len;
 	// intersect top
-	if (lineIntersect(fcx, fcy, ex, ey, -1, 0, w, 0, ix, iy))
+	if (lineIntersect(fcx, fcy, ex, ey, r.x0 - 1, r.y0, r.x1 + 1, r.y0, ix, iy))
 		return std::pair<float, float>(ix, iy);
 	// intersect right
-	if (lineIntersect(fcx, fcy, ex, ey, w - 1, -1, w - 1, h, ix, iy))
+	if (lineIntersect(fcx, fcy, ex, ey, r.x1, r.y0 - 1, r.x1, r.y1 + 1, ix, iy))
 		return std::pair<float, float>(ix, iy);
 	// intersect bottom
-	if (lineIntersect(fcx, fcy, ex, ey, -1, h - 1, w, h - 1, ix, iy))
+	if (lineIntersect(fcx, fcy, ex, ey, r.x0 - 1, r.y1, r.x1 + 1, r.y1, ix, iy))
 		return std::pair<float, float>(ix, iy);
 	// intersect left
-	if (lineIntersect(fcx, fcy, ex, ey, 0, -1, 0, h, ix, iy))
+	if (lineIntersect(fcx, fcy, ex, ey, r.x0, r.y0 - 1, r.x0, r.y1 + 1, ix, iy))
 		return std::pair<float, float>(ix, iy);
 
-	// something went wrong...
-	return std::pair<float, float>(ix, iy);
+	// degenerate rectangle
+	return std::pair<float, float>(fcx, fcy);
 }
 
 
@@ -186,53 +376,135 @@ bool poly_mutator::lineIntersect(float a0x, float a0y, float a1x, float a1y, flo
 
 
 IterPoly::IterPoly(poly_mutator& pm)
-: mutator(pm), p(pm.randPoly()), c(pm.randColor()), a(pm.randAlpha()) {
+: mutator(&pm), p(pm.randPoly()), c(pm.randColor()), a(pm.randAlpha()) {
 }
 
 
 IterPoly::IterPoly(poly_mutator& pm, const PolyDNA& d)
-: mutator(pm), p(), c(d.color), a(d.alpha) {
+: mutator(&pm), p(), c(d.color), a(d.alpha) {
 	for (auto it = d.v.cbegin(); it != d.v.cend(); ++it)
 		p.add(*it);
 	assert((a >= 0) && (a <= 1));
 }
 
 
-void IterPoly::mutate() {
-	m = mutator.randMutation();
+IterPoly::IterPoly(poly_mutator& pm, const Polygon& poly, const Color& color, const float alpha)
+: mutator(&pm), p(poly), c(color), a(alpha) {
+	assert((a >= 0) && (a <= 1));
+}
+
+
+// Mutation::Swap is done with swap()
+void IterPoly::mutate(const Mutation mutation) {
+	m = mutation;
 	switch (m) {
 	case Mutation::X:
-		index = mutator.randVertIndex();
+		index = mutator->randVertIndex(p.size());
 		pp = p.get(index).x;
-		p.setX(index, mutator.randVertX());
+		p.setX(index, mutator->randVertX());
 		break;
 	case Mutation::Y:
-		index = mutator.randVertIndex();
+		index = mutator->randVertIndex(p.size());
 		pp = p.get(index).y;
-		p.setY(index, mutator.randVertY());
+		p.setY(index, mutator->randVertY());
 		break;
 	case Mutation::R:
-		cc = c.R;
-		c.R = mutator.randColChannel();
+		c2 = c;
+		c.R = mutator->randColChannel();
+		if (mutator->gray())
+			c = Color{c.R, c.R, c.R};
 		break;
 	case Mutation::G:
-		cc = c.G;
-		c.G = mutator.randColChannel();
+		c2 = c;
+		c.G = mutator->randColChannel();
 		break;
 	case Mutation::B:
-		cc = c.B;
-		c.B = mutator.randColChannel();
+		c2 = c;
+		c.B = mutator->randColChannel();
 		break;
 	case Mutation::A:
 		a2 = a;
-		a = mutator.randAlpha();
+		a = mutator->randAlpha();
+		break;
+	case Mutation::Vertex:
+		index = mutator->randVertIndex(p.size());
+		pt = p.get(index);
+		p.set(index, mutator->perturbVert(pt));
+		break;
+	case Mutation::Translate:
+		mutator->randOffset(p.getBounds(), dx, dy);
+		p.translate(dx, dy);
+		break;
+	case Mutation::RGB:
+		c2 = c;
+		c = mutator->perturbColor(c);
+		break;
+	case Mutation::Remove:
+		// hidden until img_iter erases it
+		a2 = a;
+		a = 0;
+		break;
+	case Mutation::AddVert:
+		{
+			// split the edge after a random vertex, near its midpoint
+			const std::size_t i = mutator->randVertIndex(p.size());
+			const Point v0{p.get(i)};
+			const Point v1{p.get((i + 1) % p.size())};
+			index = i + 1;
+			p.insert(index, mutator->perturbVert(Point{(v0.x + v1.x) / 2, (v0.y + v1.y) / 2}));
+		}
+		break;
+	case Mutation::RemoveVert:
+		assert(p.size() > 3);
+		index = mutator->randVertIndex(p.size());
+		pt = p.get(index);
+		p.erase(index);
+		break;
+	case Mutation::Replace:
+		p2 = mutator->randSimplePoly();
+		p.swap(p2);
+		c2 = mutator->randColor();
+		swap(c, c2);
+		a2 = mutator->randAlpha();
+		swap(a, a2);
 		break;
 	default:
+		assert(false);
 		break;
 	}
 }
 
 
+// exchange shape and color with o, which takes this polygon's place in z-order
+// (o may be this polygon, then nothing changes)
+void IterPoly::swap(IterPoly& o) {
+	m = Mutation::Swap;
+	other = &o;
+	p.swap(o.p);
+	swap(c, o.c);
+	swap(a, o.a);
+}
+
+
+// set color and alpha computed by the caller
+void IterPoly::recolor(const Color& color, const float alpha) {
+	m = Mutation::Fit;
+	c2 = c;
+	c = color;
+	a2 = a;
+	a = alpha;
+}
+
+
+// move vertex i to position chosen by the caller
+void IterPoly::moveVert(const std::size_t i, const Point& to) {
+	m = Mutation::Search;
+	index = i;
+	pt = p.get(index);
+	p.set(index, to);
+}
+
+
 // undo the most recent change
 // should be called only between mutate()
 void IterPoly::undo() {
@@ -244,17 +516,53 @@ void IterPoly::undo() {
 		swapVertY();
 		break;
 	case Mutation::R:
-		swap(c.R, cc);
-		break;
 	case Mutation::G:
-		swap(c.G, cc);
-		break;
 	case Mutation::B:
-		swap(c.B, cc);
+		swap(c, c2);
 		break;
 	case Mutation::A:
 		swap(a, a2);
 		break;
+	case Mutation::Vertex:
+	case Mutation::Search:
+		{
+			const Point tmp{p.get(index)};
+			p.set(index, pt);
+			pt = tmp;
+		}
+		break;
+	case Mutation::Translate:
+		p.translate(-dx, -dy);
+		dx = -dx;
+		dy = -dy;
+		break;
+	case Mutation::Swap:
+		swap(*other);
+		break;
+	case Mutation::RGB:
+		swap(c, c2);
+		break;
+	case Mutation::Replace:
+		p.swap(p2);
+		swap(c, c2);
+		swap(a, a2);
+		break;
+	case Mutation::Fit:
+		swap(c, c2);
+		swap(a, a2);
+		break;
+	case Mutation::Remove:
+		swap(a, a2);
+		break;
+	case Mutation::AddVert:
+		pt = p.get(index);
+		p.erase(index);
+		m = Mutation::RemoveVert;
+		break;
+	case Mutation::RemoveVert:
+		p.insert(index, pt);
+		m = Mutation::AddVert;
+		break;
 	default:
 		break;
 	}
@@ -2,55 +2,85 @@
 
 #include "color.h"
 #include "dna.h"
+#include "error_sampler.h"
+#include "operator_selector.h"
 #include "polygon.h"
+#include "rng.h"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
-#include <limits>
-#include <random>
+#include <cstdint>
 #include <utility>
 
 
-enum class Mutation {X, Y, R, G, B, A};
+// X, Y, R, G, B, A reset one value to a random one
+// Vertex, Translate, RGB perturb by a small normal step
+// Swap exchanges z-order with another polygon (done by img_iter)
+// Replace draws a new polygon with randSimplePoly()
+// Fit sets the color and alpha that best match the image (done by img_iter)
+// Search moves a vertex to the best of several nearby positions (done by img_iter)
+// Add, Remove add a polygon on top or delete one (Add is done by img_iter)
+// AddVert, RemoveVert split an edge or delete a vertex
+enum class Mutation {X, Y, R, G, B, A, Vertex, Translate, Swap, RGB, Replace, Fit, Search,
+                     Add, Remove, AddVert, RemoveVert};
 
 
 // helper class to implement IterPoly
 class poly_mutator {
 public:
-	static constexpr int MutationCount = 6;
-	poly_mutator(const int, const int, const int, const int);
+	static constexpr int MutationCount = 17;
+	poly_mutator(const int, const int, const int, const std::uint64_t);
 	~poly_mutator() = default;
+	Polygon randSimplePoly(const Rectangle&, const float, const float);
 	Polygon randSimplePoly(const float, const float);
+	Polygon randSimplePoly(void);
 	Polygon randPoly(void);
 	Color randColor(void);
 	Color::ColorChannel randColChannel(void);
 	float randAlpha(void);
+	Point perturbVert(const Point&);
+	void randOffset(const Rectangle&, int&, int&);
+	Color perturbColor(const Color&);
 	Mutation randMutation(void);
-	std::size_t randPolyIndex(void);
-	std::size_t randVertIndex(void);
+	void reportMutation(const Mutation, const bool, const float);
+	OperatorSelector& operators(void);
+	const OperatorSelector& operators(void) const;
+	static const char* mutationName(const Mutation);
+	std::size_t randPolyIndex(const std::size_t);
+	std::size_t randVertIndex(const std::size_t);
 	int randVertX(void);
 	int randVertY(void);
+	int randBlock(void);
+	std::size_t randIndex(const std::size_t);
+	void setSampler(const ErrorSampler*);
+	void setGray(const bool);
+	bool gray(void) const;
+	int vertexCount(void) const;
+	void save(CheckpointWriter&) const;
+	bool load(CheckpointReader&);
 private:
+	bool useSampler(void);
+	int randRange(const int, const int);
 	float randNorm(void);
 	float randUni(void);
-	std::pair<float, float> getPos(const int, const int, const float, const int, const int);
+	std::pair<float, float> getPos(const int, const int, const float, const Rectangle&);
 	static bool lineIntersect(float, float, float, float, float, float, float, float, float&, float&);
+	int randStep(const float);
+	static int clamp(const int, const int, const int);
 
-	const int polyCount;
-	const int vertCount;
+	const int vertCount;	// of new polygons
 	const int width;
 	const int height;
 	static constexpr float PI = std::atan(1.0) * 4;
-	static constexpr uint_fast32_t alphaDiv = std::numeric_limits<uint_fast32_t>::max();
-	static std::uniform_int_distribution<uint_fast32_t> distAlpha;
-	static std::uniform_int_distribution<int> distMut;
-	static std::uniform_int_distribution<Color::ColorChannel> distCol;
-	std::default_random_engine re;
-	std::normal_distribution<float> distNorm;
-	std::uniform_real_distribution<float> distUni;
-	std::uniform_int_distribution<int> distVertX;
-	std::uniform_int_distribution<int> distVertY;
-	std::uniform_int_distribution<std::size_t> distPolyIndex;
-	std::uniform_int_distribution<std::size_t> distVertIndex;
+	static constexpr float guidedRate = 0.9f;	// chance of sampling by error when guided
+	static constexpr float normSigma = 0.4f;	// randNorm() standard deviation
+	static constexpr float moveSigma = 0.02f;	// vertex/translate step, fraction of larger side
+	static constexpr float colorSigma = 12.0f;	// RGB step
+	const float moveStep;	// px
+	Random rng;
+	OperatorSelector selector;
+	const ErrorSampler* sampler = nullptr;
+	bool grayColors = false;	// new and perturbed colors have R = G = B
 };
 
 
@@ -59,8 +89,12 @@ class IterPoly {
 public:
 	IterPoly(poly_mutator&);
 	IterPoly(poly_mutator&, const PolyDNA&);
+	IterPoly(poly_mutator&, const Polygon&, const Color&, const float);
 	~IterPoly() = default;
-	void mutate(void);
+	void mutate(const Mutation);
+	void swap(IterPoly&);
+	void recolor(const Color&, const float);
+	void moveVert(const std::size_t, const Point&);
 	void undo(void);
 	const Polygon& getPolygon(void) const;
 	const Color& getColor(void) const;
@@ -76,7 +110,7 @@ private:
 	void checkMinMaxX(const int);
 	void checkMinMaxY(const int);
 
-	poly_mutator& mutator;
+	poly_mutator* mutator;	// pointer so polygons can be erased from a vector
 	Polygon p;
 	Color c;
 	float a;
@@ -84,7 +118,11 @@ private:
 	// members for implementing undo()
 	std::size_t index;	// vertex index
 	int pp;		// old x or y coordinate
-	Color::ColorChannel cc;
+	Point pt;	// old vertex
+	int dx, dy;	// translation
+	Color c2;
 	float a2;
+	Polygon p2;	// replaced polygon
+	IterPoly* other = nullptr;	// swapped with
 	Mutation m;
 };
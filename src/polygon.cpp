@@ -80,6 +80,55 @@ void Polygon::setY(const std::size_t i, const int y) {
 }
 
 
+void Polygon::set(const std::size_t i, const Point& p) {
+	useCache = false;
+	v[i] = p;
+	bounds = newBounds();
+	assert(bounds.contains(v[i]));
+}
+
+
+// insert p before vertex i
+void Polygon::insert(const std::size_t i, const Point& p) {
+	useCache = false;
+	v.insert(v.begin() + i, p);
+	bounds = newBounds();
+	assert(bounds.contains(p));
+}
+
+
+void Polygon::erase(const std::size_t i) {
+	useCache = false;
+	v.erase(v.begin() + i);
+	bounds = newBounds();
+}
+
+
+// move every vertex by (dx, dy)
+// (the fill cache is rebuilt, edges accumulate in float so shifting it could
+// round differently from a fresh scan)
+void Polygon::translate(const int dx, const int dy) {
+	useCache = false;
+	for (auto it = v.begin(); it != v.end(); ++it) {
+		(*it).x += dx;
+		(*it).y += dy;
+	}
+	bounds.x0 += dx;
+	bounds.x1 += dx;
+	bounds.y0 += dy;
+	bounds.y1 += dy;
+}
+
+
+// exchange vertices, bounds and fill cache without copying
+void Polygon::swap(Polygon& other) {
+	v.swap(other.v);
+	std::swap(bounds, other.bounds);
+	fillCache.swap(other.fillCache);
+	std::swap(useCache, other.useCache);
+}
+
+
 Rectangle Polygon::getBounds() const {
 	return bounds;
 }
@@ -144,6 +193,14 @@ const std::vector<PolyHelper::FillLine>& Polygon::fillDetails() const {
 		}
 	}
 
+	if (globalTable.empty()) {
+		// all vertices on one row, polygon has no area
+		FillLine flat;
+		flat.y = bounds.y0;
+		fillLines.push_back(flat);
+		useCache = true;
+		return fillCache;
+	}
 	globalTable.sort();
 
 	std::list<FillEdge> active;
@@ -39,6 +39,11 @@ public:
 	void add(const int, const int);
 	void setX(const std::size_t, const int);
 	void setY(const std::size_t, const int);
+	void set(const std::size_t, const Point&);
+	void insert(const std::size_t, const Point&);
+	void erase(const std::size_t);
+	void translate(const int, const int);
+	void swap(Polygon&);
 	Rectangle getBounds(void) const override;
 	const Container& vertices(void) const;
 	const std::vector<PolyHelper::FillLine>& fillDetails(void) const;
@@ -0,0 +1,120 @@
+#include "pyramid.h"
+
+
+// w weights img (empty if unweighted), cfg sets up the img_iter of each level
+pyramid_seeder::pyramid_seeder(const Image& img, const Image& w, const int count, TaskScheduler& ts, const std::uint64_t seed, const Configure& cfg, std::ostream& os)
+: scheduler(ts), baseSeed(seed), configure(cfg), os(os) {
+	levels.push_back(img);
+	weights.push_back(w);
+	for (int i = 0; i < count; ++i) {
+		const Image& prev = levels.back();
+		if (prev.width() / 2 < minSize || prev.height() / 2 < minSize)
+			break;
+		levels.push_back(halve(prev));
+		weights.push_back(w.empty() ? Image() : halve(weights.back()));
+	}
+}
+
+
+// start from random polygons at the coarsest level
+DNA pyramid_seeder::seed(const int pc, const int vc) {
+	return climb(configured(img_iter::create(levels.back(), pc, vc, scheduler, baseSeed + levels.size() - 1), levels.size() - 1), levels.size() - 1);
+}
+
+
+// start from existing full resolution DNA
+DNA pyramid_seeder::seed(const DNA& d) {
+	DNA coarse{d};
+	coarse.scale(levels.front().width(), levels.front().height(), levels.back().width(), levels.back().height());
+	return climb(configured(img_iter::create(levels.back(), coarse, scheduler, baseSeed + levels.size() - 1), levels.size() - 1), levels.size() - 1);
+}
+
+
+// number of downsampled levels
+int pyramid_seeder::levelCount() const {
+	return levels.size() - 1;
+}
+
+
+// applies the run options to ii (at level), returns ii
+img_iter* pyramid_seeder::configured(img_iter* ii, const int level) const {
+	configure(*ii, weights[level]);
+	return ii;
+}
+
+
+// evolve ii (at level) and every finer level above it, returns full resolution DNA
+// takes ownership of ii
+DNA pyramid_seeder::climb(img_iter* ii, int level) {
+	DNA d;
+	while (level > 0) {
+		evolve(*ii, level);
+		d = ii->getDNA();
+		delete ii;
+		ii = nullptr;
+
+		const Image& from = levels[level];
+		const Image& to = levels[level - 1];
+		d.scale(from.width(), from.height(), to.width(), to.height());
+		--level;
+		if (level > 0)
+			ii = configured(img_iter::create(to, d, scheduler, baseSeed + level), level);
+	}
+	if (ii != nullptr) {	// no coarse levels
+		d = ii->getDNA();
+		delete ii;
+	}
+	return d;
+}
+
+
+// iterate until fitness stalls
+void pyramid_seeder::evolve(img_iter& ii, const int level) {
+	float windowFit = ii.fitness();
+	while (ii.iterations() < maxLevelIterations) {
+		ii.iterate();
+		if (ii.iterations() % stallWindow == 0) {
+			if (ii.fitness() - windowFit < stallGain)
+				break;
+			windowFit = ii.fitness();
+		}
+	}
+	os << "Level: " << level
+	   << "\tSize: " << levels[level].width() << 'x' << levels[level].height()
+	   << "\tIter: " << ii.iterations()
+	   << "\tImp: " << ii.improvements()
+	   << "\tFit: " << ii.fitness() * 100
+	   << "\tTime: " << ii.runtime() << " s"
+	   << std::endl;
+}
+
+
+// downsample by 2 (box filter), odd edges average the pixels available
+Image pyramid_seeder::halve(const Image& img) {
+	const int w = (img.width() + 1) / 2;
+	const int h = (img.height() + 1) / 2;
+	Image ret{w, h};
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			int r = 0;
+			int g = 0;
+			int b = 0;
+			int n = 0;
+			for (int sy = y * 2; sy < std::min(y * 2 + 2, img.height()); ++sy) {
+				for (int sx = x * 2; sx < std::min(x * 2 + 2, img.width()); ++sx) {
+					const Color c{img.get(sx, sy)};
+					r += c.R;
+					g += c.G;
+					b += c.B;
+					++n;
+				}
+			}
+			ret.set(x, y, Color(
+				static_cast<Color::ColorChannel>((r + n / 2) / n),
+				static_cast<Color::ColorChannel>((g + n / 2) / n),
+				static_cast<Color::ColorChannel>((b + n / 2) / n)
+			));
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "dna.h"
+#include "image.h"
+#include "img_iter.h"
+#include "task_scheduler.h"
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+
+// Coarse-to-fine seeding: DNA is evolved on downsampled copies of the source
+// image, scaled up and used to seed the next level until full resolution.
+// Every level is set up by the same Configure call, given the weights
+// downsampled with the image (empty if unweighted).
+class pyramid_seeder {
+public:
+	typedef std::function<void(img_iter&, const Image&)> Configure;
+	pyramid_seeder(const Image&, const Image&, const int, TaskScheduler&, const std::uint64_t, const Configure&, std::ostream&);
+	~pyramid_seeder() = default;
+	DNA seed(const int, const int);
+	DNA seed(const DNA&);
+	int levelCount(void) const;
+private:
+	img_iter* configured(img_iter*, const int) const;
+	DNA climb(img_iter*, int);
+	void evolve(img_iter&, const int);
+	static Image halve(const Image&);
+
+	static constexpr int minSize = 16;	// px, smallest level dimension
+	static constexpr int stallWindow = 1000;	// iterations
+	static constexpr float stallGain = 0.0005f;	// min fitness gain per window
+	static constexpr int maxLevelIterations = 200000;
+	std::vector<Image> levels;	// levels[0] is full resolution
+	std::vector<Image> weights;	// same size as levels, empty if unweighted
+	TaskScheduler& scheduler;
+	const std::uint64_t baseSeed;	// level l uses baseSeed + l
+	const Configure configure;
+	std::ostream& os;
+};
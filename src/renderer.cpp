@@ -0,0 +1,85 @@
+#include "renderer.h"
+
+
+// d evolved on a w0 x h0 image, drawn at w x h (see hasError())
+Renderer::Renderer(const DNA& d, const int w0, const int h0, const int w, const int h)
+: WIDTH(w), HEIGHT(h), background(255, 255, 255), dna(d) {
+	scaled = dna.scale(w0, h0, w, h);
+	if (!scaled)
+		return;
+	polygons.reserve(dna.data.size());
+	bounds.reserve(dna.data.size());
+	for (auto it = dna.data.cbegin(); it != dna.data.cend(); ++it) {
+		polygons.emplace_back((*it).v);
+		bounds.push_back(polygons.back().getBounds());
+	}
+}
+
+
+// Each wave first builds the fill details of the polygons starting in it,
+// then draws its bands and writes them in order. Polygons are released after
+// the last wave they cross.
+bool Renderer::render(const std::string& path, const ImageFormat format, TaskScheduler& scheduler) {
+	if (!scaled || !iw.begin(path, format, WIDTH, HEIGHT))
+		return false;
+	const int waveBands = scheduler.threadCount();
+	std::vector<std::vector<Color>> bands(waveBands);
+	std::vector<int> starting;
+	for (int y0 = 0; y0 < HEIGHT; y0 += waveBands * bandRows) {
+		const int yEnd = std::min(y0 + waveBands * bandRows, HEIGHT);
+		starting.clear();
+		for (std::size_t k = 0; k < polygons.size(); ++k) {
+			if (bounds[k].y0 >= y0 && bounds[k].y0 < yEnd)
+				starting.push_back(k);
+		}
+		auto prepare = [this, &starting] (const int i) {
+			polygons[starting[i]].fillDetails();
+		};
+		scheduler.parallelFor(0, static_cast<int>(starting.size()), 1, prepare);
+
+		const int count = (yEnd - y0 + bandRows - 1) / bandRows;
+		auto draw = [this, &bands, y0, yEnd] (const int b) {
+			const int first = y0 + b * bandRows;
+			drawBand(first, std::min(first + bandRows, yEnd) - 1, bands[b]);
+		};
+		scheduler.parallelFor(0, count, 1, draw);
+		for (int b = 0; b < count; ++b) {
+			const int rows = std::min(bandRows, yEnd - y0 - b * bandRows);
+			for (int r = 0; r < rows; ++r) {
+				if (!iw.writeRow(bands[b].data() + r * WIDTH))
+					return false;
+			}
+		}
+
+		for (std::size_t k = 0; k < polygons.size(); ++k) {
+			if (bounds[k].y1 < yEnd && bounds[k].y1 >= y0)
+				Polygon().swap(polygons[k]);
+		}
+	}
+	return iw.end();
+}
+
+
+// true if either size has no pixels, nothing is drawn then
+bool Renderer::hasError() const {
+	return !scaled;
+}
+
+
+// draws rows y0 to y1 into band (rows WIDTH pixels apart)
+void Renderer::drawBand(const int y0, const int y1, std::vector<Color>& band) const {
+	band.resize(static_cast<std::size_t>(bandRows) * WIDTH);
+	Rectangle mask;
+	mask.x0 = 0;
+	mask.y0 = y0;
+	mask.x1 = WIDTH - 1;
+	mask.y1 = y1;
+	BasicCanvas<Color> window{band.data(), WIDTH, mask};
+	window.fill(mask, background, 1.0);
+	for (std::size_t k = 0; k < polygons.size(); ++k) {
+		if (bounds[k].y0 > y1 || bounds[k].y1 < y0)
+			continue;
+		const PolyDNA& pd = dna.data[k];
+		window.fill(polygons[k], mask, pd.color, pd.alpha);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "canvas.h"
+#include "color.h"
+#include "dna.h"
+#include "file_helper.h"
+#include "polygon.h"
+#include "shape.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+// Draws a DNA at any size without an img_iter: vertices are scaled from the
+// size it was evolved on (see DNA::scale), and the output is drawn in bands
+// of rows, a wave of bands at a time across the scheduler, each streamed to
+// the ImageWriter once drawn. Memory is one wave of bands plus the fill
+// details of the polygons crossing it, whatever the output size.
+class Renderer {
+public:
+	Renderer(const DNA&, const int, const int, const int, const int);
+	Renderer(const Renderer&) = delete;
+	~Renderer() = default;
+	Renderer& operator=(const Renderer&) = delete;
+	bool render(const std::string&, const ImageFormat, TaskScheduler&);
+	bool hasError(void) const;
+private:
+	void drawBand(const int, const int, std::vector<Color>&) const;
+
+	static constexpr int bandRows = 64;
+	const int WIDTH;
+	const int HEIGHT;
+	const Color background;
+	DNA dna;	// scaled
+	bool scaled;	// false if either size has no pixels
+	std::vector<Polygon> polygons;	// emptied once drawn
+	std::vector<Rectangle> bounds;
+	ImageWriter iw;
+};
@@ -0,0 +1,126 @@
+#include "rng.h"
+
+
+// seed expands through splitmix64, stream selects a non-overlapping sequence
+Xoshiro256pp::Xoshiro256pp(const std::uint64_t seed, const std::uint64_t stream) {
+	std::uint64_t x = seed;
+	for (int i = 0; i < 4; ++i)
+		s[i] = splitmix64(x);
+	for (std::uint64_t i = 0; i < stream; ++i)
+		jump();
+}
+
+
+Xoshiro256pp::result_type Xoshiro256pp::operator()() {
+	const std::uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+	const std::uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+	return result;
+}
+
+
+void Xoshiro256pp::fill(std::uint64_t* out, const std::size_t n) {
+	// work on local copies so the state stays in registers
+	std::uint64_t s0 = s[0];
+	std::uint64_t s1 = s[1];
+	std::uint64_t s2 = s[2];
+	std::uint64_t s3 = s[3];
+	for (std::size_t i = 0; i < n; ++i) {
+		out[i] = rotl(s0 + s3, 23) + s0;
+		const std::uint64_t t = s1 << 17;
+		s2 ^= s0;
+		s3 ^= s1;
+		s1 ^= s2;
+		s0 ^= s3;
+		s2 ^= t;
+		s3 = rotl(s3, 45);
+	}
+	s[0] = s0;
+	s[1] = s1;
+	s[2] = s2;
+	s[3] = s3;
+}
+
+
+// equivalent to 2^128 calls to operator()
+void Xoshiro256pp::jump() {
+	static const std::uint64_t JUMP[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+	std::uint64_t s0 = 0;
+	std::uint64_t s1 = 0;
+	std::uint64_t s2 = 0;
+	std::uint64_t s3 = 0;
+	for (int i = 0; i < 4; ++i) {
+		for (int b = 0; b < 64; ++b) {
+			if (JUMP[i] & (static_cast<std::uint64_t>(1) << b)) {
+				s0 ^= s[0];
+				s1 ^= s[1];
+				s2 ^= s[2];
+				s3 ^= s[3];
+			}
+			(*this)();
+		}
+	}
+	s[0] = s0;
+	s[1] = s1;
+	s[2] = s2;
+	s[3] = s3;
+}
+
+
+void Xoshiro256pp::getState(std::uint64_t* out) const {
+	for (std::size_t i = 0; i < stateSize; ++i)
+		out[i] = s[i];
+}
+
+
+void Xoshiro256pp::setState(const std::uint64_t* in) {
+	for (std::size_t i = 0; i < stateSize; ++i)
+		s[i] = in[i];
+}
+
+
+std::uint64_t Xoshiro256pp::rotl(const std::uint64_t x, const int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+
+std::uint64_t splitmix64(std::uint64_t& x) {
+	std::uint64_t z = (x += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+
+// Marsaglia, Tsang: The Ziggurat Method for Generating Random Variables (2000)
+ZigguratTables::ZigguratTables() {
+	const double m1 = 2147483648.0;
+	const double vn = 9.91256303526217e-3;
+	double dn = 3.442619855899;
+	double tn = dn;
+	const double q = vn / std::exp(-0.5 * dn * dn);
+	kn[0] = static_cast<std::uint32_t>((dn / q) * m1);
+	kn[1] = 0;
+	wn[0] = static_cast<float>(q / m1);
+	wn[127] = static_cast<float>(dn / m1);
+	fn[0] = 1.0f;
+	fn[127] = static_cast<float>(std::exp(-0.5 * dn * dn));
+	for (int i = 126; i >= 1; --i) {
+		dn = std::sqrt(-2.0 * std::log(vn / dn + std::exp(-0.5 * dn * dn)));
+		kn[i + 1] = static_cast<std::uint32_t>((dn / tn) * m1);
+		tn = dn;
+		fn[i] = static_cast<float>(std::exp(-0.5 * dn * dn));
+		wn[i] = static_cast<float>(dn / m1);
+	}
+}
+
+
+const ZigguratTables& ZigguratTables::get() {
+	static const ZigguratTables tables;
+	return tables;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+
+// xoshiro256++ (Blackman, Vigna)
+// separate streams are 2^128 steps apart (jump())
+class Xoshiro256pp {
+public:
+	typedef std::uint64_t result_type;
+	static constexpr std::size_t stateSize = 4;	// words
+	Xoshiro256pp(const std::uint64_t, const std::uint64_t);
+	static constexpr result_type min() {return 0;}
+	static constexpr result_type max() {return UINT64_MAX;}
+	result_type operator()(void);
+	void fill(std::uint64_t*, const std::size_t);
+	void jump(void);
+	void getState(std::uint64_t*) const;
+	void setState(const std::uint64_t*);
+private:
+	static std::uint64_t rotl(const std::uint64_t, const int);
+	std::uint64_t s[4];
+};
+
+
+std::uint64_t splitmix64(std::uint64_t&);
+
+
+// tables for Marsaglia and Tsang's ziggurat (128 layers)
+struct ZigguratTables {
+	ZigguratTables();
+	std::uint32_t kn[128];
+	float wn[128];
+	float fn[128];
+	static const ZigguratTables& get(void);
+};
+
+
+// Buffered random source over Engine. Words are produced by Engine::fill() in
+// batches of bufferSize, so one engine call covers many mutations.
+template <class Engine>
+class RandomSource {
+public:
+	static constexpr std::size_t bufferSize = 64;
+	static constexpr std::size_t stateSize = Engine::stateSize + bufferSize + 1;	// words
+	RandomSource(const std::uint64_t, const std::uint64_t);
+	std::uint64_t next(void);
+	std::uint32_t next32(void);
+	std::uint32_t bounded(const std::uint32_t);
+	float uniform(void);
+	float uniformClosed(void);
+	float normal(void);
+	void getState(std::uint64_t*) const;
+	void setState(const std::uint64_t*);
+private:
+	float normalTail(std::int32_t, std::uint32_t);
+	void refill(void);
+
+	Engine engine;
+	std::uint64_t buffer[bufferSize];
+	std::size_t pos = bufferSize;
+};
+
+
+// engine used by poly_mutator
+typedef RandomSource<Xoshiro256pp> Random;
+
+
+template <class Engine>
+RandomSource<Engine>::RandomSource(const std::uint64_t seed, const std::uint64_t stream)
+: engine(seed, stream) {
+}
+
+
+template <class Engine>
+std::uint64_t RandomSource<Engine>::next() {
+	if (pos == bufferSize)
+		refill();
+	return buffer[pos++];
+}
+
+
+// upper bits of next() (better quality for xoshiro)
+template <class Engine>
+std::uint32_t RandomSource<Engine>::next32() {
+	return static_cast<std::uint32_t>(next() >> 32);
+}
+
+
+// unbiased integer in [0, range) (Lemire)
+template <class Engine>
+std::uint32_t RandomSource<Engine>::bounded(const std::uint32_t range) {
+	std::uint64_t m = static_cast<std::uint64_t>(next32()) * range;
+	std::uint32_t low = static_cast<std::uint32_t>(m);
+	if (low < range) {
+		const std::uint32_t threshold = (0u - range) % range;
+		while (low < threshold) {
+			m = static_cast<std::uint64_t>(next32()) * range;
+			low = static_cast<std::uint32_t>(m);
+		}
+	}
+	return static_cast<std::uint32_t>(m >> 32);
+}
+
+
+// [0, 1)
+template <class Engine>
+float RandomSource<Engine>::uniform() {
+	return static_cast<float>(next() >> 40) * (1.0f / 16777216.0f);
+}
+
+
+// [0, 1]
+template <class Engine>
+float RandomSource<Engine>::uniformClosed() {
+	return static_cast<float>(next() >> 40) * (1.0f / 16777215.0f);
+}
+
+
+// standard normal (ziggurat)
+template <class Engine>
+float RandomSource<Engine>::normal() {
+	const ZigguratTables& z = ZigguratTables::get();
+	const std::int32_t hz = static_cast<std::int32_t>(next32());
+	const std::uint32_t iz = hz & 127;
+	const std::uint32_t ahz = hz < 0 ? 0u - static_cast<std::uint32_t>(hz) : static_cast<std::uint32_t>(hz);
+	if (ahz < z.kn[iz])
+		return hz * z.wn[iz];
+	return normalTail(hz, iz);
+}
+
+
+// wedges and tail of the ziggurat
+template <class Engine>
+float RandomSource<Engine>::normalTail(std::int32_t hz, std::uint32_t iz) {
+	const ZigguratTables& z = ZigguratTables::get();
+	static constexpr float r = 3.442620f;
+	while (true) {
+		const float x = hz * z.wn[iz];
+		if (iz == 0) {
+			float tx;
+			float ty;
+			do {
+				tx = -std::log(1.0f - uniform()) * 0.2904764f;
+				ty = -std::log(1.0f - uniform());
+			} while (ty + ty < tx * tx);
+			return hz > 0 ? r + tx : -r - tx;
+		}
+		if (z.fn[iz] + uniform() * (z.fn[iz - 1] - z.fn[iz]) < std::exp(-0.5f * x * x))
+			return x;
+		hz = static_cast<std::int32_t>(next32());
+		iz = hz & 127;
+		const std::uint32_t ahz = hz < 0 ? 0u - static_cast<std::uint32_t>(hz) : static_cast<std::uint32_t>(hz);
+		if (ahz < z.kn[iz])
+			return hz * z.wn[iz];
+	}
+}
+
+
+// engine state, unused buffered words and position (stateSize words), so a
+// restored source continues the same sequence
+template <class Engine>
+void RandomSource<Engine>::getState(std::uint64_t* out) const {
+	engine.getState(out);
+	for (std::size_t i = 0; i < bufferSize; ++i)
+		out[Engine::stateSize + i] = buffer[i];
+	out[stateSize - 1] = pos;
+}
+
+
+template <class Engine>
+void RandomSource<Engine>::setState(const std::uint64_t* in) {
+	engine.setState(in);
+	for (std::size_t i = 0; i < bufferSize; ++i)
+		buffer[i] = in[Engine::stateSize + i];
+	pos = in[stateSize - 1] < bufferSize ? in[stateSize - 1] : bufferSize;
+}
+
+
+template <class Engine>
+void RandomSource<Engine>::refill() {
+	engine.fill(buffer, bufferSize);
+	pos = 0;
+}
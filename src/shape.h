@@ -13,6 +13,7 @@ public:
 	Point(const Point&);
 	Point(const int, const int);
 	~Point() = default;
+	Point& operator=(const Point&) = default;
 
 	int x;
 	int y;
@@ -0,0 +1,203 @@
+#include "task_scheduler.h"
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+thread_local const TaskScheduler* TaskScheduler::current = nullptr;
+thread_local int TaskScheduler::workerIndex = -1;
+
+
+TaskDeque::TaskDeque() : top(0), bottom(0) {
+	for (long i = 0; i < capacity; ++i)
+		buffer[i].store(nullptr, std::memory_order_relaxed);
+}
+
+
+// returns false if deque is full
+bool TaskDeque::push(Task* t) {
+	const long b = bottom.load(std::memory_order_relaxed);
+	const long tp = top.load(std::memory_order_acquire);
+	if (b - tp >= capacity)
+		return false;
+	buffer[b & (capacity - 1)].store(t, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_release);	// publishes *t to steal()
+	return true;
+}
+
+
+Task* TaskDeque::pop() {
+	const long b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long tp = top.load(std::memory_order_relaxed);
+	Task* t = nullptr;
+	if (tp <= b) {
+		t = buffer[b & (capacity - 1)].load(std::memory_order_relaxed);
+		if (tp == b) {
+			// last task, race against thieves
+			if (!top.compare_exchange_strong(tp, tp + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				t = nullptr;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+	}
+	else {
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return t;
+}
+
+
+Task* TaskDeque::steal() {
+	long tp = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const long b = bottom.load(std::memory_order_acquire);
+	if (tp >= b)
+		return nullptr;
+	Task* t = buffer[tp & (capacity - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(tp, tp + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;	// lost race
+	return t;
+}
+
+
+TaskScheduler::TaskScheduler(const int n, const bool pin)
+: threads(std::max(n, 1)), pinned(pin), queued(0), sleeping(0), stop(false) {
+	deques.reserve(threads);
+	for (int i = 0; i < threads; ++i)
+		deques.push_back(new TaskDeque);
+
+	current = this;
+	workerIndex = 0;
+	if (pinned)
+		pinThread(0);
+	workers.reserve(threads - 1);
+	for (int i = 1; i < threads; ++i)
+		workers.emplace_back(&TaskScheduler::workerLoop, this, i);
+}
+
+
+TaskScheduler::~TaskScheduler() {
+	{
+		std::lock_guard<std::mutex> lock{sleepMutex};
+		stop.store(true);
+	}
+	sleepCV.notify_all();
+	for (auto it = workers.begin(); it != workers.end(); ++it)
+		(*it).join();
+	for (auto it = deques.begin(); it != deques.end(); ++it)
+		delete *it;
+	if (current == this) {
+		current = nullptr;
+		workerIndex = -1;
+	}
+}
+
+
+int TaskScheduler::threadCount() const {
+	return threads;
+}
+
+
+// submit tasks[1..count) to this thread's deque, run tasks[0], then help until done
+void TaskScheduler::run(Task* tasks, const int count, std::atomic<int>& pending) {
+	const int self = workerIndex;
+	TaskDeque& dq = *deques[self];
+	int pushed = 0;
+	for (int i = 1; i < count; ++i) {
+		if (dq.push(&tasks[i]))
+			++pushed;
+		else
+			execute(&tasks[i]);
+	}
+	if (pushed > 0) {
+		queued.fetch_add(pushed);
+		wake();
+	}
+	execute(&tasks[0]);
+
+	while (pending.load(std::memory_order_acquire) > 0) {
+		Task* t = findTask(self);
+		if (t != nullptr)
+			execute(t);
+		else
+			std::this_thread::yield();
+	}
+}
+
+
+void TaskScheduler::workerLoop(const int index) {
+	current = this;
+	workerIndex = index;
+	if (pinned)
+		pinThread(index);
+	int idle = 0;
+	while (!stop.load(std::memory_order_relaxed)) {
+		Task* t = findTask(index);
+		if (t != nullptr) {
+			execute(t);
+			idle = 0;
+			continue;
+		}
+		if (++idle < spinCount) {
+			std::this_thread::yield();
+			continue;
+		}
+		// nothing to steal, sleep until work is queued
+		std::unique_lock<std::mutex> lock{sleepMutex};
+		sleeping.fetch_add(1);
+		sleepCV.wait(lock, [this] {return queued.load() > 0 || stop.load();});
+		sleeping.fetch_sub(1);
+		idle = 0;
+	}
+}
+
+
+// own deque first, then steal from the others
+Task* TaskScheduler::findTask(const int self) {
+	Task* t = deques[self]->pop();
+	if (t == nullptr) {
+		for (int i = 1; i < threads && t == nullptr; ++i)
+			t = deques[(self + i) % threads]->steal();
+	}
+	if (t != nullptr)
+		queued.fetch_sub(1);
+	return t;
+}
+
+
+void TaskScheduler::execute(Task* t) {
+	t->func(t->data, t->begin, t->end);
+	t->pending->fetch_sub(1, std::memory_order_release);
+}
+
+
+void TaskScheduler::wake() {
+	if (sleeping.load() > 0) {
+		std::lock_guard<std::mutex> lock{sleepMutex};
+		sleepCV.notify_all();
+	}
+}
+
+
+// only the owner thread and this scheduler's workers may submit work
+bool TaskScheduler::canSubmit() const {
+	return current == this && workerIndex >= 0;
+}
+
+
+// pin calling thread to a core
+void TaskScheduler::pinThread(const int index) {
+#ifdef __linux__
+	const unsigned int cores = std::thread::hardware_concurrency();
+	if (cores == 0)
+		return;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(index % cores, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+	(void)index;
+#endif
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// a range of work: func(data, begin, end)
+struct Task {
+	typedef void (*Function)(void*, const int, const int);
+	Function func;
+	void* data;
+	int begin;
+	int end;
+	std::atomic<int>* pending;	// decremented when finished
+};
+
+
+// fixed capacity Chase-Lev deque
+// owner thread calls push() and pop(), any thread may call steal()
+class TaskDeque {
+public:
+	TaskDeque();
+	TaskDeque(const TaskDeque&) = delete;
+	~TaskDeque() = default;
+	TaskDeque& operator=(const TaskDeque&) = delete;
+	bool push(Task*);
+	Task* pop(void);
+	Task* steal(void);
+private:
+	static constexpr long capacity = 1024;	// must be power of 2
+	std::atomic<long> top;
+	std::atomic<long> bottom;
+	std::atomic<Task*> buffer[capacity];
+};
+
+
+// Work-stealing scheduler shared by every parallel path.
+// The thread that constructs the scheduler owns deque 0 and takes part in
+// the work it submits; threadCount() - 1 worker threads are started.
+class TaskScheduler {
+public:
+	TaskScheduler(const int, const bool);
+	TaskScheduler(const TaskScheduler&) = delete;
+	~TaskScheduler();
+	TaskScheduler& operator=(const TaskScheduler&) = delete;
+	int threadCount(void) const;
+	template <class F> void parallelFor(const int, const int, const int, F&);
+private:
+	template <class F> static void invoke(void*, const int, const int);
+	void run(Task*, const int, std::atomic<int>&);
+	void workerLoop(const int);
+	Task* findTask(const int);
+	void execute(Task*);
+	void wake(void);
+	bool canSubmit(void) const;
+	static void pinThread(const int);
+
+	static constexpr int maxTasks = 64;	// tasks per parallelFor call
+	static constexpr int spinCount = 64;	// attempts before a worker sleeps
+	static thread_local const TaskScheduler* current;	// scheduler of worker thread
+	static thread_local int workerIndex;
+	const int threads;
+	const bool pinned;
+	std::vector<TaskDeque*> deques;
+	std::vector<std::thread> workers;
+	std::atomic<int> queued;
+	std::atomic<int> sleeping;
+	std::atomic<bool> stop;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCV;
+};
+
+
+// calls f(i) for every i in [begin, end), split into ranges of at least grain
+template <class F>
+void TaskScheduler::parallelFor(const int begin, const int end, const int grain, F& f) {
+	const int n = end - begin;
+	if (n <= 0)
+		return;
+	if (threads == 1 || n <= grain || !canSubmit()) {
+		invoke<F>(&f, begin, end);
+		return;
+	}
+
+	const int chunk = std::max(grain, (n + maxTasks - 1) / maxTasks);
+	Task tasks[maxTasks];
+	std::atomic<int> pending{0};
+	int count = 0;
+	for (int b = begin; b < end; b += chunk, ++count) {
+		tasks[count].func = &invoke<F>;
+		tasks[count].data = &f;
+		tasks[count].begin = b;
+		tasks[count].end = std::min(b + chunk, end);
+		tasks[count].pending = &pending;
+	}
+	pending.store(count);
+	run(tasks, count, pending);
+}
+
+
+template <class F>
+void TaskScheduler::invoke(void* data, const int begin, const int end) {
+	F& f = *static_cast<F*>(data);
+	for (int i = begin; i < end; ++i)
+		f(i);
+}
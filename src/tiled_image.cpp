@@ -0,0 +1,292 @@
+#include "tiled_image.h"
+
+
+template <class Pixel>
+constexpr char TiledImage<Pixel>::magic[];
+
+
+template <class Pixel>
+TiledImage<Pixel>::TiledImage(const int w, const int h, const int ts)
+: WIDTH(w), HEIGHT(h), size(ts),
+  countX(w % ts == 0 ? w / ts : w / ts + 1),
+  countY(h % ts == 0 ? h / ts : h / ts + 1),
+  tileBytes(static_cast<std::size_t>(ts) * ts * sizeof(Pixel)),
+  tiles(new Tile[countX * countY]), residentCount(0) {
+	for (int k = 0; k < countX * countY; ++k) {
+		tiles[k].data.store(nullptr);
+		tiles[k].used.store(0);
+		tiles[k].dirty.store(false);
+		tiles[k].stored = false;
+		tiles[k].shared = false;
+	}
+}
+
+
+template <class Pixel>
+TiledImage<Pixel>::~TiledImage() {
+	delete[] tiles;
+	if (spillFile.is_open()) {
+		spillFile.close();
+		std::remove(spillPath.c_str());
+	}
+}
+
+
+// Tiles are read from the tile file at path (see build()) instead of memory,
+// the image must be empty. False if the file does not match this image.
+template <class Pixel>
+bool TiledImage<Pixel>::map(const std::string& path) {
+	assert(residentCount == 0);
+	if (!source.open(path, false))
+		return false;
+	const unsigned char* p = source.data();
+	auto get32 = [p] (const int i) {
+		return static_cast<std::uint32_t>(p[i]) | p[i + 1] << 8 | p[i + 2] << 16 | static_cast<std::uint32_t>(p[i + 3]) << 24;
+	};
+	if (source.size() != headerSize + tileBytes * countX * countY || std::memcmp(p, magic, sizeof(magic)) != 0 ||
+	    (p[4] | p[5] << 8) != version || p[6] != sizeof(Pixel) ||
+	    static_cast<int>(get32(8)) != WIDTH || static_cast<int>(get32(12)) != HEIGHT || static_cast<int>(get32(16)) != size) {
+		source.close();
+		return false;
+	}
+	return true;
+}
+
+
+// Evicted dirty tiles are written to path. It is removed right away where
+// an open file can be, else with the image.
+template <class Pixel>
+bool TiledImage<Pixel>::spill(const std::string& path) {
+	spillFile.open(path, std::fstream::in | std::fstream::out | std::fstream::binary | std::fstream::trunc);
+	spillPath = path;
+	if (spillFile.is_open())
+		std::remove(path.c_str());
+	return spillFile.is_open();
+}
+
+
+template <class Pixel>
+void TiledImage<Pixel>::assign(const Image& img) {
+	assert(img.width() == WIDTH && img.height() == HEIGHT);
+	for (int y = 0; y < HEIGHT; ++y) {
+		const Color* src = img.row(y);
+		for (int i = 0; i < countX; ++i) {
+			Pixel* dst = tile(i, y / size) + (y % size) * size;
+			const int xLim = std::min((i + 1) * size, WIDTH);
+			for (int x = i * size; x < xLim; ++x)
+				dst[x - i * size] = Pixel(src[x]);
+		}
+	}
+}
+
+
+// bytes of resident tiles allowed after trim(), 0 keeps every tile
+template <class Pixel>
+void TiledImage<Pixel>::setBudget(const std::size_t bytes) {
+	budget = bytes == 0 ? 0 : std::max<std::size_t>(bytes / tileBytes, 1);
+}
+
+
+// Evicts least recently used tiles when over budget. A quarter of the budget
+// is freed at a time, so the tiles are not sorted on every call.
+template <class Pixel>
+void TiledImage<Pixel>::trim() {
+	++epoch;
+	if (budget == 0 || residentCount <= budget)
+		return;
+	std::vector<int> in;
+	in.reserve(residentCount);
+	for (int k = 0; k < countX * countY; ++k) {
+		if (tiles[k].data.load(std::memory_order_relaxed) != nullptr)
+			in.push_back(k);
+	}
+	const std::size_t keep = budget - budget / 4;
+	if (in.size() <= keep)
+		return;
+	const auto last = in.begin() + (in.size() - keep);
+	std::nth_element(in.begin(), last, in.end(), [this] (const int a, const int b) {
+		return tiles[a].used.load(std::memory_order_relaxed) < tiles[b].used.load(std::memory_order_relaxed);
+	});
+	for (auto it = in.begin(); it != last; ++it)
+		evict(*it);
+}
+
+
+// tile (i, j) for writing
+template <class Pixel>
+Pixel* TiledImage<Pixel>::tile(const int i, const int j) {
+	assert(source.data() == nullptr);
+	Pixel* p = const_cast<Pixel*>(static_cast<const TiledImage&>(*this).tile(i, j));
+	Tile& t = tiles[j * countX + i];
+	if (t.shared) {	// the holder keeps the old buffer
+		Pixel* copy = new Pixel[size * size];
+		std::copy(p, p + size * size, copy);
+		t.owner.reset(copy, std::default_delete<Pixel[]>());
+		t.data.store(copy, std::memory_order_release);
+		t.shared = false;
+		p = copy;
+	}
+	t.dirty.store(true, std::memory_order_relaxed);
+	return p;
+}
+
+
+// pixel (x, y) of the tile is at [(y % tileSize()) * tileSize() + x % tileSize()]
+template <class Pixel>
+const Pixel* TiledImage<Pixel>::tile(const int i, const int j) const {
+	assert(i >= 0 && i < countX && j >= 0 && j < countY);
+	const int k = j * countX + i;
+	const Pixel* p = tiles[k].data.load(std::memory_order_acquire);
+	if (p == nullptr)
+		p = load(k);
+	tiles[k].used.store(epoch, std::memory_order_relaxed);
+	return p;
+}
+
+
+// every tile, index j * countX + i as for tile(i, j), not for mapped images
+template <class Pixel>
+std::vector<std::shared_ptr<const Pixel>> TiledImage<Pixel>::share() const {
+	assert(source.data() == nullptr);
+	std::vector<std::shared_ptr<const Pixel>> ret(countX * countY);
+	for (int k = 0; k < countX * countY; ++k) {
+		if (tiles[k].data.load(std::memory_order_relaxed) == nullptr)
+			load(k);
+		ret[k] = tiles[k].owner;
+		tiles[k].shared = true;
+	}
+	return ret;
+}
+
+
+template <class Pixel>
+Pixel TiledImage<Pixel>::get(const int x, const int y) const {
+	return tile(x / size, y / size)[(y % size) * size + x % size];
+}
+
+
+template <class Pixel>
+BasicImage<Pixel> TiledImage<Pixel>::getImage() const {
+	BasicImage<Pixel> img{WIDTH, HEIGHT};
+	for (int y = 0; y < HEIGHT; ++y) {
+		Pixel* dst = img.row(y);
+		for (int i = 0; i < countX; ++i) {
+			const Pixel* src = tile(i, y / size) + (y % size) * size;
+			std::copy(src, src + std::min(size, WIDTH - i * size), dst + i * size);
+		}
+	}
+	return img;
+}
+
+
+template <class Pixel>
+int TiledImage<Pixel>::width() const {
+	return WIDTH;
+}
+
+
+template <class Pixel>
+int TiledImage<Pixel>::height() const {
+	return HEIGHT;
+}
+
+
+template <class Pixel>
+int TiledImage<Pixel>::tileSize() const {
+	return size;
+}
+
+
+// bytes of resident tiles
+template <class Pixel>
+std::size_t TiledImage<Pixel>::resident() const {
+	return residentCount * tileBytes;
+}
+
+
+// Writes the tile file of rows with tiles of ts px, one band of tiles at a
+// time, so memory use is one band whatever the image size.
+template <class Pixel>
+bool TiledImage<Pixel>::build(const std::string& path, const FileHelper::PPMRows& rows, const int ts) {
+	const int w = rows.width();
+	const int h = rows.height();
+	const int cx = w % ts == 0 ? w / ts : w / ts + 1;
+	unsigned char header[headerSize] = {};
+	std::memcpy(header, magic, sizeof(magic));
+	header[4] = version;
+	header[5] = version >> 8;
+	header[6] = sizeof(Pixel);
+	const std::uint32_t values[3] = {static_cast<std::uint32_t>(w), static_cast<std::uint32_t>(h), static_cast<std::uint32_t>(ts)};
+	for (int v = 0; v < 3; ++v) {
+		for (int b = 0; b < 4; ++b)
+			header[8 + 4 * v + b] = values[v] >> (8 * b);
+	}
+	FileHelper::AtomicFile f;
+	if (!f.open(path) || !f.write(header, headerSize))
+		return false;
+
+	std::vector<Color> row(w);
+	std::vector<Pixel> band(static_cast<std::size_t>(cx) * ts * ts);
+	for (int y0 = 0; y0 < h; y0 += ts) {
+		std::fill(band.begin(), band.end(), Pixel());
+		const int yLim = std::min(y0 + ts, h);
+		for (int y = y0; y < yLim; ++y) {
+			rows.read(y, row.data());
+			for (int x = 0; x < w; ++x)
+				band[(x / ts) * ts * ts + (y - y0) * ts + x % ts] = Pixel(row[x]);
+		}
+		rows.release(yLim);
+		if (!f.write(band.data(), band.size() * sizeof(Pixel)))
+			return false;
+	}
+	return f.commit();
+}
+
+
+// materializes tile k: from the mapped file, from the spill file, or new
+template <class Pixel>
+const Pixel* TiledImage<Pixel>::load(const int k) const {
+	std::lock_guard<std::mutex> lock(loadMutex);
+	Pixel* p = tiles[k].data.load(std::memory_order_relaxed);
+	if (p != nullptr)
+		return p;
+	if (source.data() != nullptr) {
+		p = reinterpret_cast<Pixel*>(const_cast<unsigned char*>(source.data()) + headerSize + k * tileBytes);
+	}
+	else {
+		p = new Pixel[size * size];
+		tiles[k].owner.reset(p, std::default_delete<Pixel[]>());
+		if (tiles[k].stored) {
+			spillFile.seekg(static_cast<std::streamoff>(k) * tileBytes);
+			spillFile.read(reinterpret_cast<char*>(p), tileBytes);
+		}
+	}
+	++residentCount;
+	tiles[k].data.store(p, std::memory_order_release);
+	return p;
+}
+
+
+template <class Pixel>
+void TiledImage<Pixel>::evict(const int k) {
+	Pixel* p = tiles[k].data.load(std::memory_order_relaxed);
+	if (source.data() != nullptr) {
+		source.release(headerSize + k * tileBytes, tileBytes);
+	}
+	else {
+		if (spillFile.is_open() && tiles[k].dirty.load(std::memory_order_relaxed)) {
+			spillFile.seekp(static_cast<std::streamoff>(k) * tileBytes);
+			spillFile.write(reinterpret_cast<const char*>(p), tileBytes);
+			tiles[k].stored = true;
+		}
+		tiles[k].owner.reset();
+		tiles[k].shared = false;
+	}
+	tiles[k].data.store(nullptr, std::memory_order_relaxed);
+	tiles[k].dirty.store(false, std::memory_order_relaxed);
+	--residentCount;
+}
+
+
+template class TiledImage<Color>;
+template class TiledImage<Gray8>;
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "color.h"
+#include "file_helper.h"
+#include "image.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Image stored as square tiles, each materialized on its first access (edge
+// tiles are padded to full size, rows of a tile are contiguous). By default
+// every tile stays resident. With a budget, trim() evicts the least recently
+// used tiles beyond it: tiles of a mapped tile file are released to the OS,
+// dirty tiles of a spilled image are written to its spill file, and the
+// content of any other tile is dropped (scratch).
+// share() hands out the tiles as they are: a shared tile is copied on its
+// next write, so the holder reads it unchanged on any thread.
+// tile() may be called concurrently, trim() and share() only while no tile
+// is in use.
+//
+// Tile file: "IITL" u16 version, u8 bytes per pixel, u8 0, u32 width,
+// u32 height, u32 tile size, then the tiles row by row, little-endian.
+template <class Pixel>
+class TiledImage {
+public:
+	TiledImage(const int, const int, const int);
+	TiledImage(const TiledImage&) = delete;
+	~TiledImage();
+	TiledImage& operator=(const TiledImage&) = delete;
+	bool map(const std::string&);
+	bool spill(const std::string&);
+	void assign(const Image&);
+	void setBudget(const std::size_t);
+	void trim(void);
+	Pixel* tile(const int, const int);
+	const Pixel* tile(const int, const int) const;
+	std::vector<std::shared_ptr<const Pixel>> share(void) const;
+	Pixel get(const int, const int) const;
+	BasicImage<Pixel> getImage(void) const;
+	int width(void) const;
+	int height(void) const;
+	int tileSize(void) const;
+	std::size_t resident(void) const;
+	static bool build(const std::string&, const FileHelper::PPMRows&, const int);
+private:
+	struct Tile {
+		std::atomic<Pixel*> data;
+		std::atomic<unsigned int> used;	// trim() epoch of the last access
+		std::atomic<bool> dirty;
+		bool stored;	// in the spill file
+		bool shared;	// owner is also held by share(), copy before writing
+		std::shared_ptr<Pixel> owner;	// data unless mapped
+	};
+
+	const Pixel* load(const int) const;
+	void evict(const int);
+
+	static constexpr char magic[4] = {'I', 'I', 'T', 'L'};
+	static constexpr std::uint16_t version = 1;
+	static constexpr std::size_t headerSize = 20;
+	const int WIDTH;
+	const int HEIGHT;
+	const int size;	// px per tile side
+	const int countX;
+	const int countY;
+	const std::size_t tileBytes;
+	Tile* tiles;
+	mutable std::mutex loadMutex;
+	mutable std::atomic<std::size_t> residentCount;
+	FileHelper::MappedFile source;	// tiles point into it if mapped
+	mutable std::fstream spillFile;
+	std::string spillPath;
+	std::size_t budget = 0;	// tiles, 0 keeps every tile
+	unsigned int epoch = 0;
+};